@@ -0,0 +1,158 @@
+#include "distance_table.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace std::literals;
+
+namespace
+{
+	// The map the table replaced: keyed by a pair of stop pointers, hashed as the catalogue did
+	// and looked up by count then at. Raw pointers stand in for its shared_ptrs
+	struct Stop
+	{
+		domain::StopId id;
+	};
+	using StopsPair = std::pair<const Stop*, const Stop*>;
+
+	class StopsPairHasher
+	{
+	public:
+		size_t operator()(const StopsPair& stops_pair) const
+		{
+			return hash_(stops_pair.first) + hash_(stops_pair.second) * 37 * 37;
+		}
+
+	private:
+		std::hash<const void*> hash_;
+	};
+
+	using OldDistances = std::unordered_map<StopsPair, int, StopsPairHasher>;
+
+	double Milliseconds(std::chrono::steady_clock::duration duration)
+	{
+		return std::chrono::duration<double, std::milli>(duration).count();
+	}
+
+	// Buckets and nodes as libstdc++ lays them out; the allocator's own overhead is not counted
+	size_t EstimateBytes(const OldDistances& distances)
+	{
+		const size_t node_bytes = sizeof(void*) + sizeof(OldDistances::value_type) + sizeof(size_t);
+		return distances.bucket_count() * sizeof(void*) + distances.size() * node_bytes;
+	}
+
+	// Every stop gets per_stop distances to random stops, then lookups of stored pairs are timed,
+	// half of them asked the reverse way so that they miss first and fall back as
+	// GetActualDistanceBetweenStops does. Each structure is built and queried twice and the
+	// second round is reported
+	void Run(size_t stop_count, size_t per_stop, size_t lookup_count)
+	{
+		std::mt19937 random(1u);
+		std::vector<Stop> stops(stop_count);
+		for (size_t i = 0u; i < stop_count; ++i)
+		{
+			stops[i].id = static_cast<domain::StopId>(i);
+		}
+		std::vector<std::pair<domain::StopId, domain::StopId>> pairs;
+		pairs.reserve(stop_count * per_stop);
+		for (size_t from = 0u; from < stop_count; ++from)
+		{
+			for (size_t i = 0u; i < per_stop; ++i)
+			{
+				pairs.emplace_back(static_cast<domain::StopId>(from), static_cast<domain::StopId>(random() % stop_count));
+			}
+		}
+		std::vector<std::pair<domain::StopId, domain::StopId>> lookups;
+		lookups.reserve(lookup_count);
+		for (size_t i = 0u; i < lookup_count; ++i)
+		{
+			const auto [from, to] = pairs[random() % pairs.size()];
+			lookups.push_back(i % 2u == 0u ? std::make_pair(from, to) : std::make_pair(to, from));
+		}
+
+		for (int round = 0; round < 2; ++round)
+		{
+			const auto old_start = std::chrono::steady_clock::now();
+			OldDistances old_distances;
+			for (const auto& [from, to] : pairs)
+			{
+				old_distances[{ &stops[from], &stops[to] }] = static_cast<int>(from ^ to);
+			}
+			const auto old_built = std::chrono::steady_clock::now();
+			long old_sum = 0;
+			for (const auto& [from, to] : lookups)
+			{
+				const StopsPair forward = { &stops[from], &stops[to] };
+				const StopsPair backward = { &stops[to], &stops[from] };
+				if (old_distances.count(forward))
+				{
+					old_sum += old_distances.at(forward);
+				}
+				else if (old_distances.count(backward))
+				{
+					old_sum += old_distances.at(backward);
+				}
+			}
+			const auto old_done = std::chrono::steady_clock::now();
+
+			transport::DistanceTable table;
+			for (const auto& [from, to] : pairs)
+			{
+				table.Set(from, to, static_cast<int>(from ^ to));
+			}
+			const auto table_built = std::chrono::steady_clock::now();
+			long table_sum = 0;
+			for (const auto& [from, to] : lookups)
+			{
+				std::optional<int> distance = table.Find(from, to);
+				if (!distance)
+				{
+					distance = table.Find(to, from);
+				}
+				table_sum += distance.value_or(0);
+			}
+			const auto table_done = std::chrono::steady_clock::now();
+
+			if (old_sum != table_sum)
+			{
+				std::cerr << "The structures disagree"sv << std::endl;
+				std::exit(1);
+			}
+			if (round == 0) { continue; }
+
+			const double per_lookup = 1e6 / static_cast<double>(lookup_count);
+			std::cout << std::fixed << std::setprecision(1)
+				<< table.Size() << " entries\n"sv
+				<< "  unordered_map  build "sv << Milliseconds(old_built - old_start) << " ms, lookup "sv
+				<< Milliseconds(old_done - old_built) * per_lookup << " ns, ~"sv << EstimateBytes(old_distances) / 1e6 << " MB\n"sv
+				<< "  DistanceTable  build "sv << Milliseconds(table_built - old_done) << " ms, lookup "sv
+				<< Milliseconds(table_done - table_built) * per_lookup << " ns, "sv << memory::TotalBytes(table.MemoryReport()) / 1e6 << " MB\n"sv;
+		}
+	}
+}
+
+// distance_table_benchmark [stop_count per_stop]: 6000, 100000 and 400000 stops of 10 distances
+// each without arguments. Meant for an optimized build
+int main(int argc, char* argv[])
+{
+	const size_t lookup_count = 20000000u;
+	if (argc == 3)
+	{
+		Run(std::stoul(argv[1]), std::stoul(argv[2]), lookup_count);
+		return 0;
+	}
+	for (const size_t stop_count : { 6000u, 100000u, 400000u })
+	{
+		Run(stop_count, 10u, lookup_count);
+	}
+	return 0;
+}
@@ -0,0 +1,122 @@
+#include "json_reader.h"
+#include "test_helpers.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+
+using namespace std::literals;
+
+namespace
+{
+	std::atomic<size_t> allocations{ 0u };
+}
+
+// GCC takes the free of a pointer from this operator new, once inlined into a caller, for
+// a mismatched pair
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t size)
+{
+	allocations.fetch_add(1u, std::memory_order_relaxed);
+	if (void* memory = std::malloc(size == 0u ? 1u : size))
+	{
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+namespace
+{
+	// Best time and the allocations of one run, the same every run
+	struct Phase
+	{
+		std::string name;
+		double milliseconds = 0.0;
+		size_t allocations = 0u;
+	};
+
+	template <typename Run>
+	void Measure(Phase& phase, Run&& run)
+	{
+		const size_t before = allocations.load();
+		const auto start = std::chrono::steady_clock::now();
+		run();
+		const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		phase.allocations = allocations.load() - before;
+		phase.milliseconds = (phase.milliseconds == 0.0) ? milliseconds : std::min(phase.milliseconds, milliseconds);
+	}
+}
+
+// serialization_benchmark [stop_count bus_count]: a generated network, 5000 stops and 50000 buses
+// without arguments. Times the phases make_base and process_requests spend in the base and
+// counts their allocations: parsing the make_base document, building the message and writing
+// it, reading it and filling the catalogue. Meant for an optimized build
+int main(int argc, char* argv[])
+{
+	const size_t stop_count = (argc == 3) ? std::stoul(argv[1]) : 5000u;
+	const size_t bus_count = (argc == 3) ? std::stoul(argv[2]) : 50000u;
+	const tests::TempFile file("serialization_benchmark.db"s);
+	std::ostringstream input_stream;
+	json::Print(json::Document(json::Node(tests::MakeBaseInput(tests::MakeNetwork(stop_count, bus_count, 1u), file.Path()))), input_stream);
+	const std::string input = input_stream.str();
+
+	// update_base onto an empty base writes what make_base would, without the router that
+	// make_base builds and does not store
+	tests::MakeBase(tests::MakeBaseInput({}, file.Path()));
+	renderer::MapRenderer mr;
+	request_handler::RequestHandler rh(mr);
+	{
+		json_reader::JsonReader reader(rh);
+		std::istringstream stream(input);
+		reader.UpdateBase(stream);
+	}
+
+	Phase load{ "load"s };
+	Phase serialize{ "serialize"s };
+	Phase deserialize{ "deserialize"s };
+	for (int round = 0; round < 3; ++round)
+	{
+		Measure(load, [&]()
+		{
+			std::istringstream stream(input);
+			const json::Document document = json::Load(stream);
+		});
+
+		// A copy of the built version, written as make_base writes it
+		rh.BeginUpdate();
+		Measure(serialize, [&]() { rh.Serialize(); });
+		rh.PublishDraft();
+
+		renderer::MapRenderer loaded_mr;
+		request_handler::RequestHandler loaded_rh(loaded_mr);
+		loaded_rh.SetSerializationSettings(file.Path());
+		Measure(deserialize, [&]() { loaded_rh.Deserialize(); });
+	}
+
+	std::cout << stop_count << " stops, "sv << bus_count << " buses, "sv << input.size() << " bytes of input\n"sv;
+	for (const Phase& phase : { load, serialize, deserialize })
+	{
+		std::cout << std::fixed << std::setprecision(1) << "  "sv << std::left << std::setw(12) << phase.name
+			<< std::right << std::setw(9) << phase.milliseconds << " ms "sv << std::setw(10) << phase.allocations << " allocations\n"sv;
+	}
+	return 0;
+}
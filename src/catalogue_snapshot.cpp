@@ -0,0 +1,109 @@
+#include "catalogue_snapshot.h"
+
+#include <thread>
+#include <utility>
+
+namespace transport
+{
+	namespace
+	{
+		// The entry a reader thread is copying the reference of. Slots are shared by every holder,
+		// taken by a thread on its first Acquire, handed on to another thread once it exits and
+		// never freed, so there are as many as threads have ever read at once
+		struct HazardSlot
+		{
+			std::atomic<const void*> entry{ nullptr };
+			std::atomic<bool> taken{ false };
+			HazardSlot* next = nullptr;
+		};
+
+		std::atomic<HazardSlot*> hazard_slots{ nullptr };
+
+		HazardSlot* TakeSlot()
+		{
+			for (HazardSlot* slot = hazard_slots.load(); slot != nullptr; slot = slot->next)
+			{
+				bool taken = false;
+				if (slot->taken.compare_exchange_strong(taken, true))
+				{
+					return slot;
+				}
+			}
+			HazardSlot* slot = new HazardSlot;
+			slot->taken.store(true, std::memory_order_relaxed);
+			slot->next = hazard_slots.load();
+			while (!hazard_slots.compare_exchange_weak(slot->next, slot))
+			{
+			}
+			return slot;
+		}
+
+		// Gives the slot back when the thread exits
+		struct ThreadSlot
+		{
+			HazardSlot* slot = TakeSlot();
+
+			~ThreadSlot()
+			{
+				slot->taken.store(false, std::memory_order_release);
+			}
+		};
+
+		HazardSlot& CurrentThreadSlot()
+		{
+			thread_local ThreadSlot thread_slot;
+			return *thread_slot.slot;
+		}
+
+		bool IsMarked(const void* entry)
+		{
+			for (const HazardSlot* slot = hazard_slots.load(); slot != nullptr; slot = slot->next)
+			{
+				if (slot->entry.load() == entry)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+	}
+
+	Snapshot::Snapshot(const TransportCatalogue& base) : catalogue(base)
+	{
+	}
+
+	SnapshotHolder::~SnapshotHolder()
+	{
+		delete current_.load();
+	}
+
+	std::shared_ptr<const Snapshot> SnapshotHolder::Acquire() const
+	{
+		HazardSlot& slot = CurrentThreadSlot();
+		// Once the mark is seen, a writer that has not yet swapped the entry out will not free
+		// it; one that already has is caught by the second load
+		const Entry* entry = current_.load();
+		while (entry != nullptr)
+		{
+			slot.entry.store(entry);
+			const Entry* current = current_.load();
+			if (current == entry) { break; }
+			entry = current;
+		}
+		std::shared_ptr<const Snapshot> snapshot = entry ? entry->snapshot : nullptr;
+		slot.entry.store(nullptr, std::memory_order_release);
+		return snapshot;
+	}
+
+	void SnapshotHolder::Publish(std::shared_ptr<const Snapshot> next)
+	{
+		const std::lock_guard<std::mutex> lock(publish_mutex_);
+		const Entry* replaced = current_.exchange(next ? new Entry{ std::move(next) } : nullptr);
+		// Readers that marked it before the exchange are only copying its reference
+		while (replaced != nullptr && IsMarked(replaced))
+		{
+			std::this_thread::yield();
+		}
+		delete replaced;
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace transport
+{
+	// One immutable version of everything the queries read. The router's names point into
+	// this catalogue, so the two are only ever built and published together
+	struct Snapshot
+	{
+		Snapshot() = default;
+		// Starts the next version from a copy of the given data; indexes and router are built anew
+		explicit Snapshot(const TransportCatalogue& base);
+
+		TransportCatalogue catalogue;
+		Router router;
+	};
+
+	// Read-copy-update publication of snapshots. A writer fills the next version on the side and
+	// swaps it in with one atomic exchange. A reader takes no lock: it marks the entry it is about
+	// to copy in a hazard slot of its thread, checks that the entry is still current and copies
+	// the reference, retrying only if a version was published in between. The writer frees a
+	// replaced entry once no slot marks it, so it is the writer that waits, never a reader. The
+	// version itself is freed by whoever drops the last reference to it
+	class SnapshotHolder
+	{
+	public:
+		SnapshotHolder() = default;
+		SnapshotHolder(const SnapshotHolder&) = delete;
+		SnapshotHolder& operator=(const SnapshotHolder&) = delete;
+		~SnapshotHolder();
+
+		// Empty until the first Publish
+		std::shared_ptr<const Snapshot> Acquire() const;
+		// Publishers go one at a time
+		void Publish(std::shared_ptr<const Snapshot> next);
+
+	private:
+		// Never changed once published, so that readers copy its reference without a lock
+		struct Entry
+		{
+			std::shared_ptr<const Snapshot> snapshot;
+		};
+
+		std::atomic<const Entry*> current_{ nullptr };
+		std::mutex publish_mutex_;
+	};
+}
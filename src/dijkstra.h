@@ -0,0 +1,215 @@
+#pragma once
+
+#include "graph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Limits one or several searches; settled vertices are counted across all of them
+struct SearchBudget {
+    using Clock = std::chrono::steady_clock;
+
+    std::optional<size_t> max_settled_vertices;
+    std::optional<Clock::time_point> deadline;
+
+    size_t settled_vertices = 0;
+    bool exceeded = false;
+
+    // Accounts one settled vertex, false once the budget is spent
+    bool Spend() {
+        ++settled_vertices;
+        if (max_settled_vertices && settled_vertices > *max_settled_vertices) {
+            exceeded = true;
+        }
+        // Reading the clock on every vertex would cost more than the relaxation itself
+        else if (deadline && settled_vertices % DEADLINE_CHECK_PERIOD == 0 && Clock::now() >= *deadline) {
+            exceeded = true;
+        }
+        return !exceeded;
+    }
+
+    static constexpr size_t DEADLINE_CHECK_PERIOD = 64;
+};
+
+// Point-to-point search over the graph topology with edge weights supplied
+// per query, so a customized metric needs no preprocessing of its own
+template <typename Weight>
+class DijkstraRouter {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    explicit DijkstraRouter(const Graph& graph);
+
+    using Endpoint = RouteEndpoint<Weight>;
+    using Path = RoutePath<Weight>;
+
+    // weights[edge_id] replaces the weight stored in the graph. A search that runs
+    // out of budget stops early and returns the best route reached so far, if any.
+    // Search state lives in per-thread buffers reused by the following searches
+    bool BuildRoute(const std::vector<Endpoint>& sources, const std::vector<Endpoint>& targets,
+                    const std::vector<Weight>& weights, Path& path, SearchBudget* budget = nullptr) const;
+
+private:
+    struct VertexState {
+        std::optional<Weight> weight;
+        std::optional<EdgeId> prev_edge;
+        size_t source_index = 0;
+        bool settled = false;
+        // Best offset to a target at this vertex, several candidates may share it
+        std::optional<std::pair<Weight, size_t>> target_offset;
+    };
+    using QueueItem = std::pair<Weight, VertexId>;
+
+    struct SearchState {
+        std::vector<VertexState> vertices;
+        std::vector<VertexId> touched;  // vertices to reset before the next search
+        std::vector<QueueItem> queue;   // binary min-heap
+
+        void Prepare(size_t vertex_count) {
+            for (const VertexId vertex : touched) {
+                if (vertex < vertices.size()) {
+                    vertices[vertex] = VertexState{};
+                }
+            }
+            touched.clear();
+            queue.clear();
+            if (vertices.size() < vertex_count) {
+                vertices.resize(vertex_count);
+            }
+        }
+
+        VertexState& Touch(VertexId vertex) {
+            touched.push_back(vertex);
+            return vertices[vertex];
+        }
+
+        void Push(Weight weight, VertexId vertex) {
+            queue.push_back({weight, vertex});
+            std::push_heap(queue.begin(), queue.end(), std::greater<QueueItem>{});
+        }
+
+        QueueItem Pop() {
+            std::pop_heap(queue.begin(), queue.end(), std::greater<QueueItem>{});
+            const QueueItem item = queue.back();
+            queue.pop_back();
+            return item;
+        }
+    };
+
+    static SearchState& GetSearchState() {
+        thread_local SearchState state;
+        return state;
+    }
+
+    const Graph& graph_;
+};
+
+template <typename Weight>
+DijkstraRouter<Weight>::DijkstraRouter(const Graph& graph)
+    : graph_(graph) {
+}
+
+template <typename Weight>
+bool DijkstraRouter<Weight>::BuildRoute(const std::vector<Endpoint>& sources, const std::vector<Endpoint>& targets,
+                                        const std::vector<Weight>& weights, Path& path, SearchBudget* budget) const {
+    if (weights.size() != graph_.GetEdgeCount()) {
+        throw std::invalid_argument("Weights should be given for every edge");
+    }
+
+    SearchState& search = GetSearchState();
+    search.Prepare(graph_.GetVertexCount());
+    auto& vertices = search.vertices;
+
+    for (size_t source_index = 0; source_index < sources.size(); ++source_index) {
+        const Endpoint& source = sources[source_index];
+        auto& state = search.Touch(source.vertex);
+        if (!state.weight || source.offset < *state.weight) {
+            state.weight = source.offset;
+            state.source_index = source_index;
+            search.Push(source.offset, source.vertex);
+        }
+    }
+    for (size_t target_index = 0; target_index < targets.size(); ++target_index) {
+        const Endpoint& target = targets[target_index];
+        auto& target_offset = search.Touch(target.vertex).target_offset;
+        if (!target_offset || target.offset < target_offset->first) {
+            target_offset = std::pair{target.offset, target_index};
+        }
+    }
+
+    std::optional<std::pair<Weight, VertexId>> best;
+    while (!search.queue.empty()) {
+        const auto [weight, vertex] = search.Pop();
+        auto& state = vertices[vertex];
+        if (state.settled || weight != *state.weight) {
+            continue;
+        }
+        // Remaining vertices are at least this far away, even before their target offset
+        if (best && !(weight < best->first)) {
+            break;
+        }
+        if (budget && !budget->Spend()) {
+            break;
+        }
+        state.settled = true;
+
+        if (state.target_offset) {
+            const Weight total = weight + state.target_offset->first;
+            if (!best || total < best->first) {
+                best = std::pair{total, vertex};
+            }
+        }
+
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+            const Weight edge_weight = weights[edge_id];
+            if (edge_weight < Weight{}) {
+                throw std::domain_error("Edges' weights should be non-negative");
+            }
+            const VertexId to = graph_.GetEdge(edge_id).to;
+            const Weight candidate = weight + edge_weight;
+            auto& to_state = vertices[to];
+            if (!to_state.settled && (!to_state.weight || candidate < *to_state.weight)) {
+                if (!to_state.weight) {
+                    search.touched.push_back(to);
+                }
+                to_state.weight = candidate;
+                to_state.prev_edge = edge_id;
+                to_state.source_index = state.source_index;
+                search.Push(candidate, to);
+            }
+        }
+    }
+
+    if (!best) {
+        return false;
+    }
+
+    const VertexState& target_state = vertices[best->second];
+    path.weight = best->first;
+    path.source_index = target_state.source_index;
+    path.target_index = target_state.target_offset->second;
+
+    size_t length = 0;
+    for (std::optional<EdgeId> edge_id = target_state.prev_edge;
+         edge_id;
+         edge_id = vertices[graph_.GetEdge(*edge_id).from].prev_edge) {
+        ++length;
+    }
+    path.edges.resize(length);
+    for (std::optional<EdgeId> edge_id = target_state.prev_edge;
+         edge_id;
+         edge_id = vertices[graph_.GetEdge(*edge_id).from].prev_edge) {
+        path.edges[--length] = *edge_id;
+    }
+    return true;
+}
+
+}  // namespace graph
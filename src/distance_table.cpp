@@ -0,0 +1,92 @@
+#include "distance_table.h"
+
+#include <algorithm>
+
+namespace transport
+{
+	namespace
+	{
+		// splitmix64 finalizer: consecutive ids spread over the whole table
+		uint64_t MixKey(uint64_t key)
+		{
+			key ^= key >> 30;
+			key *= 0xbf58476d1ce4e5b9ull;
+			key ^= key >> 27;
+			key *= 0x94d049bb133111ebull;
+			key ^= key >> 31;
+			return key;
+		}
+	}
+
+	void DistanceTable::Set(domain::StopId from, domain::StopId to, int distance)
+	{
+		// At most half full, so probes stay short
+		if ((size_ + 1u) * 2u > keys_.size())
+		{
+			Grow();
+		}
+
+		const uint64_t key = MakeKey(from, to);
+		const size_t slot = FindSlot(key);
+		if (keys_[slot] == EMPTY_KEY)
+		{
+			keys_[slot] = key;
+			++size_;
+		}
+		values_[slot] = distance;
+	}
+
+	std::optional<int> DistanceTable::Find(domain::StopId from, domain::StopId to) const
+	{
+		if (size_ == 0u) { return std::nullopt; }
+
+		const size_t slot = FindSlot(MakeKey(from, to));
+		return (keys_[slot] != EMPTY_KEY) ? std::optional<int>(values_[slot]) : std::nullopt;
+	}
+
+	size_t DistanceTable::Size() const
+	{
+		return size_;
+	}
+
+	memory::Report DistanceTable::MemoryReport() const
+	{
+		return { memory::Of("keys", keys_), memory::Of("values", values_) };
+	}
+
+	uint64_t DistanceTable::MakeKey(domain::StopId from, domain::StopId to)
+	{
+		return (static_cast<uint64_t>(from) << 32) | to;
+	}
+
+	size_t DistanceTable::FindSlot(uint64_t key) const
+	{
+		// keys_.size() is a power of two
+		const size_t mask = keys_.size() - 1u;
+		for (size_t slot = MixKey(key) & mask; ; slot = (slot + 1u) & mask)
+		{
+			if (keys_[slot] == key || keys_[slot] == EMPTY_KEY)
+			{
+				return slot;
+			}
+		}
+	}
+
+	void DistanceTable::Grow()
+	{
+		std::vector<uint64_t> keys(std::max<size_t>(16u, keys_.size() * 2u), EMPTY_KEY);
+		std::vector<int> values(keys.size());
+		keys.swap(keys_);
+		values.swap(values_);
+
+		for (size_t slot = 0u; slot < keys.size(); ++slot)
+		{
+			if (keys[slot] != EMPTY_KEY)
+			{
+				const size_t new_slot = FindSlot(keys[slot]);
+				keys_[new_slot] = keys[slot];
+				values_[new_slot] = values[slot];
+			}
+		}
+	}
+}
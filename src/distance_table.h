@@ -0,0 +1,49 @@
+#pragma once
+
+#include "domain.h"
+#include "memory_report.h"
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace transport
+{
+	// Road distances keyed by (from << 32) | to in one flat open-addressing table.
+	// Keys and values sit in parallel arrays, a lookup is one hash and a short linear probe
+	class DistanceTable
+	{
+	public:
+		void Set(domain::StopId from, domain::StopId to, int distance);
+		// Only the given direction; the reverse one is the caller's fallback
+		std::optional<int> Find(domain::StopId from, domain::StopId to) const;
+
+		size_t Size() const;
+		memory::Report MemoryReport() const;
+
+		// visitor(from, to, distance) for every stored direction
+		template <typename Visitor>
+		void ForEach(Visitor&& visitor) const
+		{
+			for (size_t slot = 0u; slot < keys_.size(); ++slot)
+			{
+				if (keys_[slot] != EMPTY_KEY)
+				{
+					visitor(static_cast<domain::StopId>(keys_[slot] >> 32),
+						static_cast<domain::StopId>(keys_[slot]), values_[slot]);
+				}
+			}
+		}
+
+	private:
+		static constexpr uint64_t EMPTY_KEY = UINT64_MAX;     // (NO_STOP, NO_STOP) is never stored
+
+		std::vector<uint64_t> keys_;
+		std::vector<int> values_;
+		size_t size_ = 0u;
+
+		static uint64_t MakeKey(domain::StopId from, domain::StopId to);
+		size_t FindSlot(uint64_t key) const;
+		void Grow();
+	};
+}
@@ -1,13 +1,15 @@
 #include "domain.h"
 
+#include <algorithm>
+#include <numeric>
 #include <utility>
 
 namespace domain 
 {
-	Bus::Bus(std::string&& name, std::vector<StopPointer>&& route, int unique, 
-            int actual, double geo, bool roundtrip, StopPointer last_stop) : 
-        name(std::make_shared<std::string>(std::move(name))), 
-        route(std::vector<StopPointer>(std::move(route))), 
+	Bus::Bus(std::string&& name, std::vector<StopId>&& route, int unique, 
+            int actual, double geo, bool roundtrip, StopId last_stop) : 
+        name(std::move(name)), 
+        route(std::move(route)), 
         unique_stops(unique),
         route_actual_length(actual),
         route_geographic_length(geo),
@@ -16,11 +18,33 @@ namespace domain
 
 
 	Stop::Stop(std::string&& name, double lat, double lng) 
-        : name(std::make_shared<std::string>(std::move(name))), coords({lat, lng}) {}
+        : name(std::move(name)), coords({lat, lng}) {}
 
-	double Stop::GetGeographicDistanceTo(StopPointer stop_to) const {
+	Distribution MakeDistribution(std::vector<double>& values) 
+    {
+		Distribution result;
+		if (values.empty()) { return result; }
+
+		// Each rank is selected within the part left above the previous one
+		const size_t last = values.size() - 1u;
+		const auto at = [&](size_t begin, size_t rank) 
+        {
+			std::nth_element(values.begin() + begin, values.begin() + rank, values.end());
+			return values[rank];
+		};
+		result.count = values.size();
+		result.min = *std::min_element(values.begin(), values.end());
+		result.p25 = at(0u, last / 4u);
+		result.median = at(last / 4u, last / 2u);
+		result.p75 = at(last / 2u, last * 3u / 4u);
+		result.max = *std::max_element(values.begin() + last * 3u / 4u, values.end());
+		result.mean = std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+		return result;
+	}
+
+	double Stop::GetGeographicDistanceTo(const Stop& stop_to) const {
 		return geo::ComputeDistance(
             { coords.lat, coords.lng }, 
-            { stop_to.get()->coords.lat, stop_to.get()->coords.lng });
+            { stop_to.coords.lat, stop_to.coords.lng });
 	}
 }
@@ -1,48 +1,237 @@
 #pragma once
 
 #include "geo.h"
+#include "name_arena.h"
+#include "ranges.h"
 
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
 #include <string>
 #include <string_view>
 #include <vector>
-#include <unordered_set>
-#include <memory>
 #include <optional>
 
 namespace domain 
 {
-	struct Bus;
-	using BusPointer = std::shared_ptr<Bus>;
+	// Stops and buses are addressed by dense ids: positions in the catalogue's columns
+	using StopId = uint32_t;
+	using BusId = uint32_t;
 
-	struct Stop;
-	using StopPointer = std::shared_ptr<Stop>;
+	inline constexpr StopId NO_STOP = std::numeric_limits<StopId>::max();
 
-	struct Bus 
+	// Stop attributes, one column per field, indexed by StopId; name ids are StopIds
+	struct StopsTable 
+    {
+		NameArena names;
+		std::vector<geo::Coordinates> coords;
+		std::vector<geo::LatitudeTrig> lat_trigs;   // cached for geographic distances
+		// Stop i is passed by passing_buses[passing_bus_begins[i] .. passing_bus_begins[i + 1]),
+		// built with the catalogue's indexes
+		std::vector<uint32_t> passing_bus_begins;
+		std::vector<BusId> passing_buses;
+	};
+
+	// Stops of a route in travel order, expanded on the fly: the stored stops, then for a bus that
+	// is not a roundtrip the same stops back to the first. Only the stored ones are kept anywhere
+	class RouteIterator 
+    {
+	public:
+		using iterator_category = std::random_access_iterator_tag;
+		using value_type = StopId;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const StopId*;
+		using reference = StopId;
+
+		RouteIterator() = default;
+		RouteIterator(const StopId* stops, size_t stored, size_t index) : stops_(stops), stored_(stored), index_(index) {}
+
+		StopId operator*() const { return index_ < stored_ ? stops_[index_] : stops_[2u * stored_ - 2u - index_]; }
+		StopId operator[](difference_type n) const { return *(*this + n); }
+
+		RouteIterator& operator++() { ++index_; return *this; }
+		RouteIterator operator++(int) { RouteIterator old = *this; ++index_; return old; }
+		RouteIterator& operator--() { --index_; return *this; }
+		RouteIterator operator--(int) { RouteIterator old = *this; --index_; return old; }
+		RouteIterator& operator+=(difference_type n) { index_ += n; return *this; }
+		RouteIterator& operator-=(difference_type n) { index_ -= n; return *this; }
+		RouteIterator operator+(difference_type n) const { return RouteIterator(*this) += n; }
+		RouteIterator operator-(difference_type n) const { return RouteIterator(*this) -= n; }
+		difference_type operator-(const RouteIterator& other) const 
+        {
+			return static_cast<difference_type>(index_) - static_cast<difference_type>(other.index_);
+		}
+
+		bool operator==(const RouteIterator& other) const { return index_ == other.index_; }
+		bool operator!=(const RouteIterator& other) const { return index_ != other.index_; }
+		bool operator<(const RouteIterator& other) const { return index_ < other.index_; }
+		bool operator>(const RouteIterator& other) const { return index_ > other.index_; }
+		bool operator<=(const RouteIterator& other) const { return index_ <= other.index_; }
+		bool operator>=(const RouteIterator& other) const { return index_ >= other.index_; }
+
+	private:
+		const StopId* stops_ = nullptr;
+		size_t stored_ = 0u;
+		size_t index_ = 0u;
+	};
+
+	using RouteStops = ranges::Range<RouteIterator>;
+
+	inline RouteStops MakeRouteStops(const StopId* stops, size_t stored, bool roundtrip) 
+    {
+		const size_t size = (roundtrip || stored == 0u) ? stored : 2u * stored - 1u;
+		return { RouteIterator(stops, stored, 0u), RouteIterator(stops, stored, size) };
+	}
+
+	// Bus attributes, one column per field, indexed by BusId; name ids are BusIds.
+	// Routes of all buses share one array, bus i owns [route_begins[i], route_begins[i + 1]):
+	// only the way out for a bus that is not a roundtrip, see RouteIterator
+	struct BusesTable 
+    {
+		NameArena names;
+		std::vector<uint32_t> route_begins;
+		std::vector<StopId> route_stops;
+		std::vector<int> unique_stops;
+		std::vector<int> route_actual_lengths;
+		std::vector<double> route_geographic_lengths;
+		std::vector<bool> roundtrips;
+		std::vector<StopId> last_stops;     // NO_STOP when the bus has no separate last stop
+	};
+
+	// Input record of a stop, consumed by TransportCatalogue::AddStop
+	struct Stop 
     {
-		Bus(std::string&& name, std::vector<StopPointer>&& route, int unique, 
-            int actual, double geo, bool roundtrip, StopPointer last_stop = nullptr);
+		Stop(std::string&& name, double lat, double lng);
+
+		double GetGeographicDistanceTo(const Stop& stop_to) const;
+
+		std::string name;
+		geo::Coordinates coords = {0.0, 0.0};
+	};
 
-		Bus& operator=(const Bus& bus) = default;
+	// Input record of a bus, consumed by TransportCatalogue::AddBus. The route holds the stops as
+	// given; a bus that is not a roundtrip goes back along them, see RouteStops
+	struct Bus 
+    {
+		Bus(std::string&& name, std::vector<StopId>&& route, int unique,
+            int actual, double geo, bool roundtrip, StopId last_stop = NO_STOP);
 
-		std::shared_ptr<std::string> name;
-		std::vector<StopPointer> route;
+		std::string name;
+		std::vector<StopId> route;
 		int unique_stops = 0;
 		int route_actual_length = 0;
 		double route_geographic_length = 0.0;
 		bool roundtrip;
-		StopPointer last_stop;
+		StopId last_stop = NO_STOP;
 	};
 
-	struct Stop 
+	// Changes update_base applies onto a stored base. A stop or bus given again replaces the
+	// stored one; a replaced stop's road distances are replaced as a whole
+	struct BaseDelta 
     {
-		Stop(std::string&& name, double lat, double lng);
+		struct RoadDistance 
+        {
+			std::string from;
+			std::string to;
+			int distance = 0;
+		};
 
-		double GetGeographicDistanceTo(StopPointer stop_to) const;
+		std::vector<Stop> stops;                    // added or replaced
+		std::vector<RoadDistance> road_distances;   // from the stops above
+		std::vector<std::string> removed_stops;     // no bus kept may pass them
+		std::vector<std::string> removed_buses;     // buses given again are removed first
+	};
 
-		std::shared_ptr<std::string> name;
-		geo::Coordinates coords = {0.0, 0.0};
+	// Thin handle of a stop stored in the catalogue: reads the columns on demand.
+	// A default constructed view stands for "no such stop"
+	class StopView 
+    {
+	public:
+		StopView() = default;
+		StopView(const StopsTable* table, StopId id) : table_(table), id_(id) {}
+
+		explicit operator bool() const { return table_ != nullptr; }
+		bool operator==(const StopView& other) const { return table_ == other.table_ && id_ == other.id_; }
+		bool operator!=(const StopView& other) const { return !(*this == other); }
+
+		StopId Id() const { return id_; }
+		std::string_view Name() const { return table_->names.Get(id_); }
+		geo::Coordinates Coords() const { return table_->coords[id_]; }
+		// Ids of the buses passing the stop in bus name order, empty until the indexes are built
+		ranges::Range<const BusId*> PassingBuses() const 
+        {
+			if (id_ + 1u >= table_->passing_bus_begins.size()) { return { nullptr, nullptr }; }
+			const BusId* data = table_->passing_buses.data();
+			return { data + table_->passing_bus_begins[id_], data + table_->passing_bus_begins[id_ + 1u] };
+		}
+
+	private:
+		const StopsTable* table_ = nullptr;
+		StopId id_ = 0u;
+	};
+
+	// Thin handle of a bus stored in the catalogue, see StopView
+	class BusView 
+    {
+	public:
+		BusView() = default;
+		BusView(const BusesTable* table, const StopsTable* stops, BusId id) : table_(table), stops_(stops), id_(id) {}
+
+		explicit operator bool() const { return table_ != nullptr; }
+
+		BusId Id() const { return id_; }
+		std::string_view Name() const { return table_->names.Get(id_); }
+		// The stops as stored: the whole route of a roundtrip, only the way out otherwise
+		ranges::Range<const StopId*> StoredStops() const 
+        {
+			const StopId* data = table_->route_stops.data();
+			return { data + table_->route_begins[id_], data + table_->route_begins[id_ + 1u] };
+		}
+		// Every stop in travel order, the way back of a bus that is not a roundtrip included
+		RouteStops Route() const 
+        {
+			const ranges::Range<const StopId*> stored = StoredStops();
+			return MakeRouteStops(stored.begin(), stored.size(), IsRoundtrip());
+		}
+		StopView RouteStop(size_t index) const { return { stops_, Route().begin()[index] }; }
+		int UniqueStops() const { return table_->unique_stops[id_]; }
+		int RouteActualLength() const { return table_->route_actual_lengths[id_]; }
+		double RouteGeographicLength() const { return table_->route_geographic_lengths[id_]; }
+		bool IsRoundtrip() const { return table_->roundtrips[id_]; }
+		StopView LastStop() const 
+        {
+			const StopId last_stop = table_->last_stops[id_];
+			return last_stop == NO_STOP ? StopView{} : StopView{ stops_, last_stop };
+		}
+
+	private:
+		const BusesTable* table_ = nullptr;
+		const StopsTable* stops_ = nullptr;
+		BusId id_ = 0u;
 	};
 
+	// Make the views of ids for the ranges below
+	struct MakeStopView 
+    {
+		const StopsTable* stops = nullptr;
+		StopView operator()(StopId id) const { return { stops, id }; }
+	};
+
+	struct MakeBusView 
+    {
+		const BusesTable* buses = nullptr;
+		const StopsTable* stops = nullptr;
+		BusView operator()(BusId id) const { return { buses, stops, id }; }
+	};
+
+	// Stops and buses in id order or in the order of an id array, such as by name. Views are
+	// made on dereference from the columns, so walking these ranges copies nothing
+	using StopViews = ranges::Range<ranges::MappedIterator<ranges::CountingIterator<StopId>, MakeStopView>>;
+	using StopViewsByName = ranges::Range<ranges::MappedIterator<const StopId*, MakeStopView>>;
+	using BusViews = ranges::Range<ranges::MappedIterator<ranges::CountingIterator<BusId>, MakeBusView>>;
+	using BusViewsByName = ranges::Range<ranges::MappedIterator<const BusId*, MakeBusView>>;
+
 	struct BusInfo 
     {
 		std::string_view name;
@@ -55,7 +244,53 @@ namespace domain
 	struct StopInfo 
     {
 		std::string_view name;
-		const std::unordered_set<BusPointer>* passing_buses;
+		ranges::Range<const BusId*> passing_buses;
+	};
+
+	struct NearbyStop 
+    {
+		StopId stop = NO_STOP;
+		double distance = 0.0;
+	};
+
+	// Order statistics of a set of values. A quantile q is the value at rank floor(q * (count - 1))
+	// in ascending order, so the median of an even count is the lower middle value
+	struct Distribution 
+    {
+		size_t count = 0u;
+		double min = 0.0;
+		double p25 = 0.0;
+		double median = 0.0;
+		double p75 = 0.0;
+		double max = 0.0;
+		double mean = 0.0;
+	};
+
+	// Reorders the values; all zero for none
+	Distribution MakeDistribution(std::vector<double>& values);
+
+	// Which aggregates the Analytics request asks for, each is computed only if asked
+	struct AnalyticsOptions 
+    {
+		bool route_length = false;
+		bool curvature = false;
+		size_t busiest_stops = 0u;      // how many of the stops most buses pass
+		bool travel_time = false;
+	};
+
+	struct BusiestStop 
+    {
+		StopId stop = NO_STOP;
+		size_t bus_count = 0u;
+	};
+
+	struct NetworkAnalytics 
+    {
+		std::optional<double> route_length;         // metres of all routes by road
+		std::optional<double> geographic_length;    // the same along straight lines
+		std::optional<Distribution> curvature;      // over buses whose route has a length
+		std::vector<BusiestStop> busiest_stops;     // most buses first, ties in name order
+		std::optional<Distribution> travel_time;    // minutes, over ordered pairs of distinct stops with a route
 	};
 
 }
@@ -2,6 +2,7 @@
 #include <math.h>
 
 const inline int EarthRadius = 6371000;
+static const double dr = 3.1415926535 / 180.;
 
 inline bool dequal(const double num1, const double num2)
 {
@@ -15,7 +16,6 @@ double geo::ComputeDistance(Coordinates from, Coordinates to)
     {
         return 0.0;
     }
-    static const double dr = 3.1415926535 / 180.;
     return acos(
         sin(from.lat * dr) * 
         sin(to.lat * dr) + 
@@ -24,3 +24,55 @@ double geo::ComputeDistance(Coordinates from, Coordinates to)
         cos(fabs(from.lng - to.lng) * dr)
     ) * EarthRadius;
 }
+
+geo::LatitudeTrig geo::ComputeLatitudeTrig(Coordinates point) 
+{
+    return { std::sin(point.lat * dr), std::cos(point.lat * dr) };
+}
+
+namespace
+{
+    // Operations in the order of ComputeDistance, so the sums match bit for bit
+    double ComputeExactPathLength(const geo::Coordinates* points, const geo::LatitudeTrig* trigs, size_t count) 
+    {
+        using namespace std;
+        double length = 0.0;
+        for (size_t i = 1; i < count; ++i) 
+        {
+            const geo::Coordinates from = points[i - 1];
+            const geo::Coordinates to = points[i];
+            if (dequal(from.lat, to.lat) && dequal(from.lng, to.lng))
+            {
+                continue;
+            }
+            length += acos(
+                trigs[i - 1].sin_lat * 
+                trigs[i].sin_lat + 
+                trigs[i - 1].cos_lat * 
+                trigs[i].cos_lat * 
+                cos(fabs(from.lng - to.lng) * dr)
+            ) * EarthRadius;
+        }
+        return length;
+    }
+
+    // Branch-free arithmetic over the columns, which the compiler is free to vectorize
+    double ComputeApproximatePathLength(const geo::Coordinates* points, const geo::LatitudeTrig* trigs, size_t count) 
+    {
+        double length = 0.0;
+        for (size_t i = 1; i < count; ++i) 
+        {
+            const double x = (points[i].lng - points[i - 1].lng) * dr * (trigs[i - 1].cos_lat + trigs[i].cos_lat) * 0.5;
+            const double y = (points[i].lat - points[i - 1].lat) * dr;
+            length += std::sqrt(x * x + y * y);
+        }
+        return length * EarthRadius;
+    }
+}
+
+double geo::ComputePathLength(const Coordinates* points, const LatitudeTrig* trigs, size_t count, DistanceMode mode) 
+{
+    return mode == DistanceMode::EXACT 
+        ? ComputeExactPathLength(points, trigs, count) 
+        : ComputeApproximatePathLength(points, trigs, count);
+}
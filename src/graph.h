@@ -1,7 +1,10 @@
 #pragma once
 
+#include "memory_report.h"
 #include "ranges.h"
 
+#include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <vector>
 
@@ -10,6 +13,31 @@ namespace graph {
 using VertexId = size_t;
 using EdgeId = size_t;
 
+// Conversion between travel time in minutes and the weight representation
+template <typename Weight>
+struct WeightTraits {
+    static Weight FromMinutes(double minutes) {
+        return minutes;
+    }
+    static double ToMinutes(Weight weight) {
+        return weight;
+    }
+};
+
+// Fixed-point weights in centiseconds: relaxation becomes integer arithmetic,
+// so sums do not depend on the association order
+template <>
+struct WeightTraits<int32_t> {
+    static constexpr double UNITS_PER_MINUTE = 6000.0;
+
+    static int32_t FromMinutes(double minutes) {
+        return static_cast<int32_t>(std::llround(minutes * UNITS_PER_MINUTE));
+    }
+    static double ToMinutes(int32_t weight) {
+        return weight / UNITS_PER_MINUTE;
+    }
+};
+
 template <typename Weight>
 struct Edge {
     VertexId from;
@@ -17,6 +45,23 @@ struct Edge {
     Weight weight;
 };
 
+// Endpoint of a multi-source/multi-target query: a vertex plus the cost of reaching it
+template <typename Weight>
+struct RouteEndpoint {
+    VertexId vertex;
+    Weight offset;
+};
+
+// Result of a multi-source/multi-target query. Queries overwrite it in place,
+// so a caller keeping one around reuses the edges storage
+template <typename Weight>
+struct RoutePath {
+    Weight weight{};
+    std::vector<EdgeId> edges;
+    size_t source_index = 0;
+    size_t target_index = 0;
+};
+
 template <typename Weight>
 class DirectedWeightedGraph {
 private:
@@ -33,6 +78,8 @@ public:
     const Edge<Weight>& GetEdge(EdgeId edge_id) const;
     IncidentEdgesRange GetIncidentEdges(VertexId vertex) const;
 
+    memory::Report MemoryReport() const;
+
 private:
     std::vector<Edge<Weight>> edges_;
     std::vector<IncidenceList> incidence_lists_;
@@ -71,4 +118,9 @@ typename DirectedWeightedGraph<Weight>::IncidentEdgesRange
 DirectedWeightedGraph<Weight>::GetIncidentEdges(VertexId vertex) const {
     return ranges::AsRange(incidence_lists_.at(vertex));
 }
+
+template <typename Weight>
+memory::Report DirectedWeightedGraph<Weight>::MemoryReport() const {
+    return {memory::Of("edges", edges_), memory::Of("incidence_lists", incidence_lists_)};
+}
 }  // namespace graph
\ No newline at end of file
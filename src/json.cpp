@@ -245,7 +245,7 @@ void PrintValue(const Value& value, const PrintContext& ctx) {
     ctx.out << value;
 }
 
-void PrintString(const std::string& value, std::ostream& out) {
+void PrintString(std::string_view value, std::ostream& out) {
     out.put('"');
     for (const char c : value) {
         switch (c) {
@@ -348,4 +348,74 @@ void Print(const Document& doc, std::ostream& output) {
     PrintNode(doc.GetRoot(), PrintContext{output});
 }
 
-}  // namespace json
\ No newline at end of file
+Writer::Writer(std::ostream& output)
+    : output_(output) {
+}
+
+void Writer::BeginValue() {
+    if (after_key_) {
+        after_key_ = false;
+        return;
+    }
+    if (!first_) {
+        output_ << ",\n"sv;
+    }
+    first_ = false;
+    PrintContext{output_, 4, indent_}.PrintIndent();
+}
+
+Writer& Writer::StartDict() {
+    BeginValue();
+    output_ << "{\n"sv;
+    indent_ += 4;
+    first_ = true;
+    return *this;
+}
+
+Writer& Writer::EndDict() {
+    indent_ -= 4;
+    output_.put('\n');
+    PrintContext{output_, 4, indent_}.PrintIndent();
+    output_.put('}');
+    first_ = false;
+    return *this;
+}
+
+Writer& Writer::StartArray() {
+    BeginValue();
+    output_ << "[\n"sv;
+    indent_ += 4;
+    first_ = true;
+    return *this;
+}
+
+Writer& Writer::EndArray() {
+    indent_ -= 4;
+    output_.put('\n');
+    PrintContext{output_, 4, indent_}.PrintIndent();
+    output_.put(']');
+    first_ = false;
+    return *this;
+}
+
+Writer& Writer::Key(std::string_view key) {
+    BeginValue();
+    PrintString(key, output_);
+    output_ << ": "sv;
+    after_key_ = true;
+    return *this;
+}
+
+Writer& Writer::String(std::string_view value) {
+    BeginValue();
+    PrintString(value, output_);
+    return *this;
+}
+
+Writer& Writer::Value(const Node& value) {
+    BeginValue();
+    PrintNode(value, PrintContext{output_, 4, indent_});
+    return *this;
+}
+
+}  // namespace json
@@ -1,8 +1,10 @@
 #pragma once
 
+#include <cstdint>
 #include <iostream>
 #include <map>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
@@ -18,7 +20,7 @@ public:
 };
 
 class Node final
-    : private std::variant<std::nullptr_t, Array, Dict, bool, int, double, std::string> {
+    : private std::variant<std::nullptr_t, Array, Dict, bool, int, int64_t, double, std::string> {
 public:
     using variant::variant;
     using Value = variant;
@@ -34,18 +36,30 @@ public:
         return std::get<int>(*this);
     }
 
+    // Counts too large for int are built as 64-bit integers; parsing only ever yields int
+    bool IsInt64() const {
+        return IsInt() || std::holds_alternative<int64_t>(*this);
+    }
+    int64_t AsInt64() const {
+        using namespace std::literals;
+        if (!IsInt64()) {
+            throw std::logic_error("Not an integer"s);
+        }
+        return IsInt() ? AsInt() : std::get<int64_t>(*this);
+    }
+
     bool IsPureDouble() const {
         return std::holds_alternative<double>(*this);
     }
     bool IsDouble() const {
-        return IsInt() || IsPureDouble();
+        return IsInt64() || IsPureDouble();
     }
     double AsDouble() const {
         using namespace std::literals;
         if (!IsDouble()) {
             throw std::logic_error("Not a double"s);
         }
-        return IsPureDouble() ? std::get<double>(*this) : AsInt();
+        return IsPureDouble() ? std::get<double>(*this) : static_cast<double>(AsInt64());
     }
 
     bool IsBool() const {
@@ -139,4 +153,29 @@ Document Load(std::istream& input);
 
 void Print(const Document& doc, std::ostream& output);
 
+// Writes a document piece by piece in the layout of Print, without building its nodes.
+// Keys are written in the order given, so they must come sorted to match a printed Dict
+class Writer {
+public:
+    explicit Writer(std::ostream& output);
+
+    Writer& StartDict();
+    Writer& EndDict();
+    Writer& StartArray();
+    Writer& EndArray();
+
+    Writer& Key(std::string_view key);
+    Writer& String(std::string_view value);
+    Writer& Value(const Node& value);
+
+private:
+    // Separates the value from the previous one unless it follows a key
+    void BeginValue();
+
+    std::ostream& output_;
+    int indent_ = 0;
+    bool first_ = true;
+    bool after_key_ = false;
+};
+
 }  // namespace json
\ No newline at end of file
@@ -2,11 +2,14 @@
 #include "transport_router.h"
 
 #include <utility>
-#include <unordered_set>
 #include <set>
 #include <algorithm>
 #include <sstream>
+#include <stdexcept>
 #include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <limits>
 
 namespace json_reader 
 {
@@ -23,9 +26,9 @@ namespace json_reader
 
 		if (dict.count("routing_settings"s)) 
         {
-			const auto [wait, vel] = ReadRoutingSettings(dict.at("routing_settings"s).AsDict());
-			rh_.SetRoutingSettings(wait, vel);
+			rh_.SetRoutingSettings(ReadRoutingSettings(dict.at("routing_settings"s).AsDict()));
 		}
+		ReadStatSettings(dict);
 		if (dict.count("base_requests"s)) 
         {
 			FillTransportCatalogue(dict);
@@ -35,9 +38,10 @@ namespace json_reader
         {
 			rh_.SetRenderSettings(std::move(ReadRenderingSettings(dict)));
 		}
+		rh_.PublishDraft();
 		if (dict.count("stat_requests"s)) 
         {
-			AnswerStatRequests(dict, out);
+			AnswerStatRequests(dict.at("stat_requests"s).AsArray(), out);
 		}
 	}
 
@@ -49,9 +53,9 @@ namespace json_reader
 
 		if (dict.count("routing_settings"s)) 
         {
-			const auto [wait, vel] = ReadRoutingSettings(dict.at("routing_settings"s).AsDict());
-			rh_.SetRoutingSettings(wait, vel);
+			rh_.SetRoutingSettings(ReadRoutingSettings(dict.at("routing_settings"s).AsDict()));
 		}
+		ReadStatSettings(dict);
 		if (dict.count("base_requests"s)) 
         {
 			FillTransportCatalogue(dict);
@@ -66,6 +70,8 @@ namespace json_reader
 			rh_.SetSerializationSettings(dict.at("serialization_settings"s).AsDict().at("file").AsString());
 			rh_.Serialize();
 		}
+		// Published only to be inspected, e.g. by PrintMemoryReport
+		rh_.PublishDraft();
 	}
 
 	void JsonReader::ProcessRequests(std::istream& input, std::ostream& out)
@@ -78,10 +84,72 @@ namespace json_reader
         {
 			rh_.SetSerializationSettings(dict.at("serialization_settings"s).AsDict().at("file").AsString());
 			rh_.Deserialize();
+			FillGraphInRouter();
+		}
+		if (dict.count("routing_settings"s)) 
+        {
+			// Customizes the loaded router for this session, the base stays untouched
+			const auto settings = ReadRoutingSettings(dict.at("routing_settings"s).AsDict());
+			rh_.SetSessionRoutingSettings(settings.wait_time, settings.velocity);
 		}
+		rh_.PublishDraft();
 		if (dict.count("stat_requests"s)) 
         {
-			AnswerStatRequests(dict, out);
+			AnswerStatRequests(dict.at("stat_requests"s).AsArray(), out);
+		}
+	}
+
+	void JsonReader::UpdateBase(std::istream& input)
+	{
+		const json::Document doc = json::Load(input);
+		const json::Node& node = doc.GetRoot();
+		const json::Dict& dict = node.AsDict();
+
+		rh_.SetSerializationSettings(dict.at("serialization_settings"s).AsDict().at("file").AsString());
+		rh_.Deserialize();
+		// The router is not stored in the base, so it is not built here either
+		rh_.PublishDraft();
+
+		ReadStatSettings(dict);
+		rh_.BeginUpdate(ReadBaseDelta(dict));
+		if (dict.count("base_requests"s)) 
+        {
+			std::vector<Bus> buses;
+			for (const auto& req_node : dict.at("base_requests"s).AsArray()) 
+            {
+				const json::Dict& req = req_node.AsDict();
+				const bool removed = req.count("remove"s) && req.at("remove"s).AsBool();
+				if (req.at("type"s).AsString() == "Bus"s && !removed) 
+                {
+					buses.push_back(ReadBus(req));
+				}
+			}
+			rh_.AddBuses(std::move(buses));
+		}
+		rh_.BuildCatalogueIndexes();
+
+		if (dict.count("routing_settings"s)) 
+        {
+			rh_.SetRoutingSettings(ReadRoutingSettings(dict.at("routing_settings"s).AsDict()));
+		}
+		if (dict.count("render_settings"s)) 
+        {
+			rh_.SetRenderSettings(std::move(ReadRenderingSettings(dict)));
+		}
+		rh_.Serialize();
+		rh_.PublishDraft();
+	}
+
+	void JsonReader::ReadStatSettings(const json::Dict& dict) 
+    {
+		if (!dict.count("stat_settings"s)) { return; }
+		const json::Dict& settings = dict.at("stat_settings"s).AsDict();
+		// Bus curvature from approximate geographic lengths, see geo::DistanceMode. Without the
+		// setting an update keeps the mode of the base
+		if (settings.count("approximate_geographic_length"s)) 
+        {
+			rh_.SetGeographicLengthMode(settings.at("approximate_geographic_length"s).AsBool() 
+				? geo::DistanceMode::APPROXIMATE : geo::DistanceMode::EXACT);
 		}
 	}
 
@@ -107,14 +175,19 @@ namespace json_reader
 			}
 		}
 
+		// Stats of the buses need all the stops and distances, so they are computed together
+		std::vector<Bus> buses;
 		for (const auto& req_node : base_requests) 
         {
 			const json::Dict& req = req_node.AsDict();
 			if (req.at("type"s).AsString() == "Bus"s) 
             {
-				FillBus(req);
+				buses.push_back(ReadBus(req));
 			}
 		}
+		rh_.AddBuses(std::move(buses));
+
+		rh_.BuildCatalogueIndexes();
 	}
 
 	void JsonReader::FillGraphInRouter() 
@@ -134,29 +207,71 @@ namespace json_reader
 		return stop_req.at("road_distances"s).AsDict();
 	}
 
-	void JsonReader::FillBus(const json::Dict& bus_req) 
+	Bus JsonReader::ReadBus(const json::Dict& bus_req) const 
 	{
-		auto [route, unique_stops_num, last_stop] = WordsToRoute(bus_req.at("stops"s).AsArray(), bus_req.at("is_roundtrip"s).AsBool());
-		const auto [geographic, actual] = rh_.ComputeRouteLengths(route);
-		if (last_stop.get() == rh_.FindStop(route.front()).get()) 
-        {
-			Bus bus(std::move(std::string(bus_req.at("name"s).AsString())), rh_.StopsToStopPointer(std::move(route)), 
-				unique_stops_num, actual, geographic, bus_req.at("is_roundtrip"s).AsBool());
-			rh_.AddBus(std::move(bus));
-		}
-		else 
+		auto [route, last_stop] = WordsToRoute(bus_req.at("stops"s).AsArray());
+		const StopId last_stop_id = last_stop.Id() == route.front() ? NO_STOP : last_stop.Id();
+		// Stats are left to RequestHandler::AddBuses
+		return Bus(std::move(std::string(bus_req.at("name"s).AsString())), std::move(route), 
+			0, 0, 0.0, bus_req.at("is_roundtrip"s).AsBool(), last_stop_id);
+	}
+
+	BaseDelta JsonReader::ReadBaseDelta(const json::Dict& dict) const 
+    {
+		BaseDelta delta;
+		if (!dict.count("base_requests"s)) { return delta; }
+
+		for (const auto& req_node : dict.at("base_requests"s).AsArray()) 
         {
-			Bus bus(std::move(std::string(bus_req.at("name"s).AsString())), rh_.StopsToStopPointer(std::move(route)),
-				unique_stops_num, actual, geographic, bus_req.at("is_roundtrip"s).AsBool(), last_stop);
-			rh_.AddBus(std::move(bus));
+			const json::Dict& req = req_node.AsDict();
+			const std::string& name = req.at("name"s).AsString();
+			const bool is_stop = (req.at("type"s).AsString() == "Stop"s);
+			if (req.count("remove"s) && req.at("remove"s).AsBool()) 
+            {
+				(is_stop ? delta.removed_stops : delta.removed_buses).push_back(name);
+			}
+			else if (is_stop) 
+            {
+				delta.stops.emplace_back(std::string(name), 
+					GetDoubleFromNode(req.at("latitude"s)), GetDoubleFromNode(req.at("longitude"s)));
+				if (req.count("road_distances"s)) 
+                {
+					for (const auto& [stop_to, distance] : req.at("road_distances"s).AsDict()) 
+                    {
+						delta.road_distances.push_back({ name, stop_to, distance.AsInt() });
+					}
+				}
+			}
+			else 
+            {
+				delta.removed_buses.push_back(name);
+			}
 		}
+		return delta;
 	}
 
-	std::tuple<json_reader::JsonReader::BusWaitTime, json_reader::JsonReader::BusVelocity> JsonReader::ReadRoutingSettings(const json::Dict& dict) 
+	transport::Router::Settings JsonReader::ReadRoutingSettings(const json::Dict& dict) 
     {
-		const int wait_time = dict.at("bus_wait_time"s).AsInt();
-		const double velocity = GetDoubleFromNode(dict.at("bus_velocity"s));
-		return { wait_time, velocity };
+		transport::Router::Settings settings;
+		settings.wait_time = dict.at("bus_wait_time"s).AsInt();
+		settings.velocity = GetDoubleFromNode(dict.at("bus_velocity"s));
+		if (dict.count("pedestrian_velocity"s)) 
+        {
+			settings.pedestrian_velocity = GetDoubleFromNode(dict.at("pedestrian_velocity"s));
+		}
+		if (dict.count("snap_stops_count"s)) 
+        {
+			settings.snap_stops_count = dict.at("snap_stops_count"s).AsInt();
+		}
+		if (dict.count("walk_transfer_radius"s)) 
+        {
+			settings.walk_transfer_radius = GetDoubleFromNode(dict.at("walk_transfer_radius"s));
+		}
+		if (dict.count("walk_transfer_max_neighbours"s)) 
+        {
+			settings.walk_transfer_max_neighbours = dict.at("walk_transfer_max_neighbours"s).AsInt();
+		}
+		return settings;
 	}
 
 	renderer::RenderingSettings JsonReader::ReadRenderingSettings(const json::Dict& dict) 
@@ -209,6 +324,16 @@ namespace json_reader
 		return (node.IsPureDouble() ? node.AsDouble() : node.AsInt());
 	}
 
+	json::Node JsonReader::CountToNode(uint64_t count) const 
+    {
+		// Printed as an integer whatever its size; past int64_t it saturates
+		if (count <= static_cast<uint64_t>(std::numeric_limits<int>::max())) 
+        {
+			return json::Node(static_cast<int>(count));
+		}
+		return json::Node(static_cast<int64_t>(std::min<uint64_t>(count, std::numeric_limits<int64_t>::max())));
+	}
+
 	std::vector<svg::Color> JsonReader::GetColorsFromArray(const json::Array& arr) const 
     {
 		std::vector<svg::Color> result;
@@ -254,9 +379,13 @@ namespace json_reader
 		return {};
 	}
 
-	void JsonReader::AnswerStatRequests(const json::Dict& dict, std::ostream& out) const {
-		json::Array result;
-		const json::Array& stat_requests = dict.at("stat_requests"s).AsArray();
+	void JsonReader::AnswerStatRequests(const json::Array& stat_requests, std::ostream& out) const {
+		// Answers are written as they come rather than gathered into one array, so that Route
+		// answers can go straight from the router's result to the output, see WriteRouteAnswer
+		json::Writer writer(out);
+		writer.StartArray();
+		// One version answers the whole batch, even if a newer one is published meanwhile
+		const std::shared_ptr<const transport::Snapshot> snapshot = rh_.AcquireSnapshot();
 		for (const auto& req_node : stat_requests)
 		{
 			const json::Dict& req = req_node.AsDict();
@@ -265,64 +394,69 @@ namespace json_reader
 			if (type == "Stop"s)
 			{
 				node = OutStopStat(
-					rh_.GetStopInfo(req.at("name"s).AsString()),
+					*snapshot,
+					rh_.GetStopInfo(*snapshot, req.at("name"s).AsString()),
 					req.at("id"s).AsInt()
 				);
 			}
 			else if (type == "Bus"s) 
 			{
 				node = OutBusStat(
-					rh_.GetBusInfo(req.at("name"s).AsString()),
+					rh_.GetBusInfo(*snapshot, req.at("name"s).AsString()),
 					req.at("id"s).AsInt()
 				);
 			}
 			else if (type == "Route"s)
 			{
-				node = OutRouteReq(
-					req.at("from"s).AsString(),
-					req.at("to"s).AsString(),
-					req.at("id"s).AsInt()
-				);
+				transport::RouteSearchStats stats;
+				const transport::RouteInfo* route_info = GetRouteInfo(*snapshot, req, stats);
+				WriteRouteAnswer(writer, route_info, stats, req.at("id"s).AsInt());
+				continue;
+			}
+			else if (type == "Metrics"s) 
+			{
+				node = OutMetricsReq(*snapshot, req.at("id"s).AsInt());
+			}
+			else if (type == "Memory"s) 
+			{
+				node = OutMemoryReq(*snapshot, req.at("id"s).AsInt());
+			}
+			else if (type == "NearbyStops"s) 
+			{
+				node = OutNearbyStopsReq(*snapshot, req, req.at("id"s).AsInt());
+			}
+			else if (type == "Search"s) 
+			{
+				node = OutSearchReq(*snapshot, req, req.at("id"s).AsInt());
+			}
+			else if (type == "DirectBuses"s) 
+			{
+				node = OutDirectBusesReq(*snapshot, req, req.at("id"s).AsInt());
+			}
+			else if (type == "Analytics"s) 
+			{
+				node = OutAnalyticsReq(*snapshot, req, req.at("id"s).AsInt());
 			}
 			else 
 			{
-				node = OutMapReq(req.at("id"s).AsInt());
+				node = OutMapReq(*snapshot, req.at("id"s).AsInt());
 			}
-			result.push_back(std::move(node));
+			writer.Value(node);
 		}
-
-		json::Print(json::Document(json::Node(result)), out);
+		writer.EndArray();
 	}
 
-	json::Node JsonReader::OutStopStat(const std::optional<StopInfo> stop_stat, int id) const 
+	json::Node JsonReader::OutStopStat(const transport::Snapshot& snapshot, const std::optional<StopInfo> stop_stat, int id) const 
 	{
 		if (stop_stat.has_value()) 
 		{
 			json::Array arr;
-			if (stop_stat->passing_buses == nullptr) 
-			{
-				json::Dict dict = {
-					{ "buses"s,      json::Node(std::move(arr)) },
-					{ "request_id"s, json::Node(id)             }
-				};
-
-				return json::Node(std::move(dict));
-			}
-			const auto buses = *stop_stat->passing_buses;
+			// A span over the catalogue's index, already ordered by bus name
+			const auto buses = stop_stat->passing_buses;
 			arr.reserve(buses.size());
-			std::vector<BusPointer> tmp(buses.begin(), buses.end());
-			std::sort(tmp.begin(), tmp.end(),
-				[](const BusPointer& lhs, const BusPointer& rhs) 
-				{
-					return std::lexicographical_compare(
-						lhs.get()->name.get()->begin(), lhs.get()->name.get()->end(),
-						rhs.get()->name.get()->begin(), rhs.get()->name.get()->end()
-					);
-				}
-			);
-			for (const BusPointer& bus : std::move(tmp)) 
+			for (const BusId bus : buses) 
 			{
-				arr.push_back(json::Node(*bus.get()->name.get()));
+				arr.push_back(json::Node(std::string(rh_.GetBusName(snapshot, bus))));
 			}
 			json::Dict dict = {
 				{ "buses"s,      json::Node(std::move(arr)) },
@@ -366,96 +500,362 @@ namespace json_reader
 		}
 	}
 
-	json::Node JsonReader::OutRouteReq(const std::string_view from, const std::string_view to, int id) const 
+	void JsonReader::WriteRouteAnswer(json::Writer& writer, const transport::RouteInfo* route_info, 
+		const transport::RouteSearchStats& stats, int id) const 
 	{
-		const auto route_info = rh_.GetRouteInfo(from, to);
-		if (route_info) {
-			json::Array arr;
-			arr.reserve(route_info->items.size());
-			for (const auto item : route_info->items) 
+		// Keys in the order a json::Dict prints them. Names are written from the views the
+		// router filled, so the answer allocates nothing once the output stream has its buffer
+		writer.StartDict();
+		if (stats.budget_exceeded) 
+		{
+			writer.Key("budget_exceeded"sv).Value(json::Node(true));
+			writer.Key("budget_exceeded_leg"sv).Value(json::Node(static_cast<int>(stats.exceeded_leg)));
+		}
+		if (!route_info) 
+		{
+			writer.Key("error_message"sv).String("not found"sv);
+			writer.Key("request_id"sv).Value(json::Node(id));
+			writer.EndDict();
+			return;
+		}
+
+		writer.Key("items"sv).StartArray();
+		for (const auto& item : route_info->items) 
+		{
+			writer.StartDict();
+			switch (item.type) 
 			{
-				if (item.wait_item) 
+			case transport::EdgeType::WAIT:
+				writer.Key("stop_name"sv).String(item.name);
+				writer.Key("time"sv).Value(json::Node(item.time));
+				writer.Key("type"sv).String("Wait"sv);
+				break;
+			case transport::EdgeType::BUS:
+				writer.Key("bus"sv).String(item.name);
+				writer.Key("span_count"sv).Value(json::Node(item.span_count));
+				writer.Key("time"sv).Value(json::Node(item.time));
+				writer.Key("type"sv).String("Bus"sv);
+				break;
+			case transport::EdgeType::WALK:
+				if (!item.name.empty()) 
 				{
-					std::string stop_name(item.wait_item->stop_name);
-					json::Dict dict = {
-						{ "type"s,      json::Node(std::move("Wait"s))   },
-						{ "stop_name"s, json::Node(std::move(stop_name)) },
-						{ "time"s,      json::Node(item.wait_item->time) }
-					};
-					arr.push_back(std::move(dict));
+					writer.Key("from"sv).String(item.name);
 				}
-				else 
+				writer.Key("time"sv).Value(json::Node(item.time));
+				if (!item.walk_to.empty()) 
 				{
-					std::string bus_name(item.bus_item->bus_name);
-					json::Dict dict = {
-						{ "type"s,       json::Node(std::move("Bus"s))         },
-						{ "bus"s,        json::Node(std::move(bus_name))       },
-						{ "span_count"s, json::Node(item.bus_item->span_count) },
-						{ "time"s,       json::Node(item.bus_item->time)       }
-					};
-					arr.push_back(std::move(dict));
+					writer.Key("to"sv).String(item.walk_to);
 				}
+				writer.Key("type"sv).String("Walk"sv);
+				break;
 			}
+			writer.EndDict();
+		}
+		writer.EndArray();
+		writer.Key("request_id"sv).Value(json::Node(id));
+		writer.Key("total_time"sv).Value(json::Node(route_info->total_time));
+		writer.EndDict();
+	}
+
+	json::Node JsonReader::OutMapReq(const transport::Snapshot& snapshot, int id) const 
+	{
+		std::ostringstream out;
+		svg::Document doc = rh_.RenderMap(snapshot);
+		doc.Render(out);
+
+		json::Dict dict = {
+			{ "request_id"s, json::Node(id) },
+			{ "map"s, json::Node(std::move(out.str())) }
+		};
+
+		return json::Node(std::move(dict));
+	}
+
+	json::Node JsonReader::OutMetricsReq(const transport::Snapshot& snapshot, int id) const 
+	{
+		const transport::RouterMetrics metrics = rh_.GetRouterMetrics(snapshot);
+
+		json::Dict dict = {
+			{ "request_id"s,               json::Node(id)                            },
+			{ "route_requests"s,           CountToNode(metrics.route_requests)       },
+			{ "route_searches"s,           CountToNode(metrics.searches)             },
+			{ "settled_vertices"s,         CountToNode(metrics.settled_vertices)     },
+			{ "route_budget_exceeded"s,    CountToNode(metrics.budget_exceeded)      }
+		};
 
+		return json::Node(std::move(dict));
+	}
+
+	json::Node JsonReader::OutMemoryReq(const transport::Snapshot& snapshot, int id) const 
+	{
+		json::Dict dict = MemoryReportToDict(rh_.GetMemoryReport(snapshot));
+		dict.emplace("request_id"s, json::Node(id));
+		return json::Node(std::move(dict));
+	}
+
+	json::Dict JsonReader::MemoryReportToDict(const memory::Report& report) const 
+	{
+		json::Array containers;
+		containers.reserve(report.size());
+		for (const memory::Entry& entry : report) 
+		{
+			containers.emplace_back(json::Dict{
+				{ "name"s,     json::Node(entry.name)       },
+				{ "bytes"s,    CountToNode(entry.bytes)     },
+				{ "count"s,    CountToNode(entry.count)     }
+			});
+		}
+		return {
+			{ "total_bytes"s,    CountToNode(memory::TotalBytes(report)) },
+			{ "containers"s,     json::Node(std::move(containers))       }
+		};
+	}
+
+	void JsonReader::PrintMemoryReport(std::ostream& out) const 
+	{
+		const auto snapshot = rh_.AcquireSnapshot();
+		if (!snapshot) { return; }
+		json::Print(json::Document(json::Node(MemoryReportToDict(rh_.GetMemoryReport(*snapshot)))), out);
+		out << std::endl;
+	}
+
+	json::Node JsonReader::OutNearbyStopsReq(const transport::Snapshot& snapshot, const json::Dict& req, int id) const 
+	{
+		std::optional<size_t> count;
+		std::optional<double> radius;
+		if (req.count("count"s)) 
+		{
+			count = static_cast<size_t>(std::max(req.at("count"s).AsInt(), 0));
+		}
+		if (req.count("radius"s)) 
+		{
+			radius = GetDoubleFromNode(req.at("radius"s));
+		}
+		if (!count && !radius) 
+		{
 			json::Dict dict = {
-				{ "request_id"s, json::Node(id)                     },
-				{ "total_time"s, json::Node(route_info->total_time) },
-				{ "items"s,      json::Node(std::move(arr))         }
+				{ "request_id"s,    json::Node(id)                              },
+				{ "error_message"s, json::Node(std::move("invalid request"s))   }
 			};
 
 			return json::Node(std::move(dict));
 		}
-		else 
+
+		const geo::Coordinates point{ GetDoubleFromNode(req.at("lat"s)), GetDoubleFromNode(req.at("lng"s)) };
+		json::Array stops;
+		for (const auto& nearby : rh_.FindNearbyStops(snapshot, point, count, radius)) 
 		{
-			json::Dict dict = {
-				{ "request_id"s,    json::Node(id)                      },
-				{ "error_message"s, json::Node(std::move("not found"s)) }
+			json::Dict stop = {
+				{ "name"s,     json::Node(std::string(rh_.GetStopName(snapshot, nearby.stop))) },
+				{ "distance"s, json::Node(nearby.distance)                           }
 			};
+			stops.push_back(json::Node(std::move(stop)));
+		}
 
-			return json::Node(std::move(dict));
+		json::Dict dict = {
+			{ "request_id"s, json::Node(id)                },
+			{ "stops"s,      json::Node(std::move(stops))  }
+		};
+
+		return json::Node(std::move(dict));
+	}
+
+	json::Node JsonReader::OutSearchReq(const transport::Snapshot& snapshot, const json::Dict& req, int id) const 
+	{
+		// Prefix search by default; with max_edits names may also differ by that many characters
+		const std::string& query = req.at("query"s).AsString();
+		const size_t max_edits = req.count("max_edits"s) ? static_cast<size_t>(std::max(req.at("max_edits"s).AsInt(), 0)) : 0u;
+		const bool as_prefix = req.count("prefix"s) ? req.at("prefix"s).AsBool() : true;
+
+		json::Array stops;
+		for (const StopId stop : rh_.SearchStops(snapshot, query, max_edits, as_prefix)) 
+		{
+			stops.push_back(json::Node(std::string(rh_.GetStopName(snapshot, stop))));
 		}
+		json::Array buses;
+		for (const BusId bus : rh_.SearchBuses(snapshot, query, max_edits, as_prefix)) 
+		{
+			buses.push_back(json::Node(std::string(rh_.GetBusName(snapshot, bus))));
+		}
+
+		json::Dict dict = {
+			{ "buses"s,      json::Node(std::move(buses)) },
+			{ "request_id"s, json::Node(id)               },
+			{ "stops"s,      json::Node(std::move(stops)) }
+		};
+
+		return json::Node(std::move(dict));
 	}
 
-	json::Node JsonReader::OutMapReq(int id) const 
+	json::Node JsonReader::OutAnalyticsReq(const transport::Snapshot& snapshot, const json::Dict& req, int id) const 
 	{
-		std::ostringstream out;
-		svg::Document doc = rh_.RenderMap();
-		doc.Render(out);
+		// Every aggregate is off unless its flag is set; busiest_stops gives how many stops to list
+		const auto flag = [&req](const std::string& key) { return req.count(key) && req.at(key).AsBool(); };
+		AnalyticsOptions options;
+		options.route_length = flag("route_length"s);
+		options.curvature = flag("curvature"s);
+		options.busiest_stops = req.count("busiest_stops"s) ? static_cast<size_t>(std::max(req.at("busiest_stops"s).AsInt(), 0)) : 0u;
+		options.travel_time = flag("travel_time"s);
+
+		const NetworkAnalytics analytics = rh_.GetNetworkAnalytics(snapshot, options);
+		json::Dict dict = {
+			{ "request_id"s, json::Node(id) }
+		};
+		if (analytics.route_length) 
+		{
+			json::Dict lengths = {
+				{ "actual_km"s,     json::Node(*analytics.route_length / 1000.0)      },
+				{ "geographic_km"s, json::Node(*analytics.geographic_length / 1000.0) }
+			};
+			dict.emplace("route_length"s, json::Node(std::move(lengths)));
+		}
+		if (analytics.curvature) 
+		{
+			dict.emplace("curvature"s, json::Node(DistributionToDict(*analytics.curvature)));
+		}
+		if (options.busiest_stops > 0u) 
+		{
+			json::Array stops;
+			for (const BusiestStop& stop : analytics.busiest_stops) 
+			{
+				json::Dict stop_dict = {
+					{ "name"s,      json::Node(std::string(rh_.GetStopName(snapshot, stop.stop))) },
+					{ "bus_count"s, CountToNode(stop.bus_count)                                   }
+				};
+				stops.push_back(json::Node(std::move(stop_dict)));
+			}
+			dict.emplace("busiest_stops"s, json::Node(std::move(stops)));
+		}
+		if (options.travel_time) 
+		{
+			// null when the routes table is not built
+			dict.emplace("travel_time"s, analytics.travel_time ? json::Node(DistributionToDict(*analytics.travel_time)) : json::Node());
+		}
+
+		return json::Node(std::move(dict));
+	}
+
+	json::Dict JsonReader::DistributionToDict(const Distribution& distribution) const 
+	{
+		return {
+			{ "count"s,  CountToNode(distribution.count)                  },
+			{ "min"s,    json::Node(distribution.min)                     },
+			{ "p25"s,    json::Node(distribution.p25)                     },
+			{ "median"s, json::Node(distribution.median)                  },
+			{ "p75"s,    json::Node(distribution.p75)                     },
+			{ "max"s,    json::Node(distribution.max)                     },
+			{ "mean"s,   json::Node(distribution.mean)                    }
+		};
+	}
+
+	json::Node JsonReader::OutDirectBusesReq(const transport::Snapshot& snapshot, const json::Dict& req, int id) const 
+	{
+		// Any bus passing both stops by default; with "ordered" only buses going from one to the other
+		const bool ordered = req.count("ordered"s) ? req.at("ordered"s).AsBool() : false;
+		const auto buses = rh_.FindDirectBuses(snapshot, req.at("from"s).AsString(), req.at("to"s).AsString(), ordered);
+		if (!buses) 
+		{
+			json::Dict dict = {
+				{ "request_id"s,    json::Node(id)                          },
+				{ "error_message"s, json::Node(std::move("not found"s))     }
+			};
+
+			return json::Node(std::move(dict));
+		}
+
+		json::Array names;
+		names.reserve(buses->size());
+		for (const BusId bus : *buses) 
+		{
+			names.push_back(json::Node(std::string(rh_.GetBusName(snapshot, bus))));
+		}
 
 		json::Dict dict = {
-			{ "request_id"s, json::Node(id) },
-			{ "map"s, json::Node(std::move(out.str())) }
+			{ "buses"s,      json::Node(std::move(names)) },
+			{ "request_id"s, json::Node(id)               }
 		};
 
 		return json::Node(std::move(dict));
 	}
 
-	std::tuple<std::vector<std::string_view>, int, StopPointer> JsonReader::WordsToRoute(const json::Array& words, bool is_roundtrip) const {
-		std::vector<std::string_view> result;
-		std::unordered_set<std::string_view, std::hash<std::string_view>> stops_unique_names;
-		result.reserve(words.size());
+	const transport::RouteInfo* JsonReader::GetRouteInfo(const transport::Snapshot& snapshot, const json::Dict& req, transport::RouteSearchStats& stats) const 
+	{
+		// Reused by every query of the thread, so once warmed up the router fills them without
+		// allocating as long as the base or session metric is used; see WriteRouteAnswer for the answer
+		thread_local transport::RouteInfo route_info;
+		thread_local std::vector<std::string_view> via;
 
-		for (size_t i = 0u; i < words.size(); ++i) 
+		transport::RouteOptions options;
+		if (req.count("bus_wait_time"s)) 
+		{
+			options.bus_wait_time = GetDoubleFromNode(req.at("bus_wait_time"s));
+		}
+		if (req.count("bus_velocity"s)) 
+		{
+			options.bus_velocity = GetDoubleFromNode(req.at("bus_velocity"s));
+		}
+		// Too long for the short string buffer, so the key is built once rather than per request
+		static const std::string max_settled_vertices_key = "max_settled_vertices"s;
+		if (req.count(max_settled_vertices_key)) 
+		{
+			options.max_settled_vertices = req.at(max_settled_vertices_key).AsInt();
+		}
+		if (req.count("time_budget_ms"s)) 
 		{
-			StopPointer stop = rh_.FindStop(words[i].AsString());
-			result.push_back(*stop.get()->name.get());
-			stops_unique_names.insert(words[i].AsString());
+			options.time_budget = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+				std::chrono::duration<double, std::milli>(GetDoubleFromNode(req.at("time_budget_ms"s))));
 		}
-		const StopPointer last_stop = rh_.FindStop(result.back());
 
-		if (!is_roundtrip && words.size() > 1u) // Go back if roundtrip
+		if (req.count("from"s) && req.count("to"s)) 
+		{
+			via.clear();
+			if (req.count("via"s)) 
+			{
+				const json::Array& via_arr = req.at("via"s).AsArray();
+				for (const auto& stop_node : via_arr) 
+				{
+					via.push_back(stop_node.AsString());
+				}
+			}
+			const bool found = rh_.GetRouteInfo(snapshot, req.at("from"s).AsString(), req.at("to"s).AsString(), via, options, route_info, &stats);
+			return found ? &route_info : nullptr;
+		}
+
+		// At least one endpoint is given by coordinates, "via" is not supported here
+		const bool found = rh_.GetRouteInfo(snapshot, ReadRouteEndpoint(snapshot, req, "from"s), ReadRouteEndpoint(snapshot, req, "to"s), options, route_info, &stats);
+		return found ? &route_info : nullptr;
+	}
+
+	std::vector<transport::SnappedStop> JsonReader::ReadRouteEndpoint(const transport::Snapshot& snapshot, const json::Dict& req, const std::string& key) const 
+	{
+		if (req.count(key)) 
+		{
+			const StopView stop = rh_.FindStop(snapshot, req.at(key).AsString());
+			if (!stop) { return {}; }
+			return { { stop.Id(), stop.Name(), 0.0 } };
+		}
+		const json::Dict& coords = req.at(key + "_coords"s).AsDict();
+		return rh_.SnapToStops(snapshot, { GetDoubleFromNode(coords.at("lat"s)), GetDoubleFromNode(coords.at("lng"s)) });
+	}
+
+	std::tuple<std::vector<StopId>, StopView> JsonReader::WordsToRoute(const json::Array& words) const {
+		std::vector<StopId> result;
+		result.reserve(words.size());
+
+		for (size_t i = 0u; i < words.size(); ++i) 
 		{
-			result.reserve(words.size() * 2u);
-			for (int i = (int)words.size() - 2; i >= 0; --i) 
+			const StopView stop = rh_.FindStop(words[i].AsString());
+			if (!stop) 
 			{
-				StopPointer stop = rh_.FindStop(words[i].AsString());
-				result.push_back(*stop.get()->name.get());
+				throw std::invalid_argument("Unknown stop \""s + words[i].AsString() + "\" on a bus route"s);
 			}
+			result.push_back(stop.Id());
 		}
+		const StopView last_stop = rh_.FindStop(words.back().AsString());
 
+		// The way back of a bus that is not a roundtrip is not stored, see domain::RouteStops
 		return {
 			std::move(result),
-			static_cast<int>(stops_unique_names.size()),
 			last_stop
 		};
 	}
@@ -4,6 +4,7 @@
 #include "transport_catalogue.h"
 #include "request_handler.h"
 
+#include <cstdint>
 #include <iostream>
 #include <tuple>
 #include <string_view>
@@ -15,36 +16,56 @@ namespace json_reader
 {
 	class JsonReader 
     {
-	private:
-		using BusWaitTime = int;
-		using BusVelocity = double;
-
 	public:
 		JsonReader(request_handler::RequestHandler& req_handler);
 		void Start(std::istream& input, std::ostream& out);
 
 		void MakeBase(std::istream& input);
 		void ProcessRequests(std::istream& input, std::ostream& out);
+		// Applies base_requests onto the stored base and writes it back, see domain::BaseDelta.
+		// A request with "remove": true removes the stop or bus of that name
+		void UpdateBase(std::istream& input);
+		// Memory report of the version the last mode built or loaded, as JSON
+		void PrintMemoryReport(std::ostream& out) const;
+		// Answers the stat requests from the published version, as one JSON array
+		void AnswerStatRequests(const json::Array& stat_requests, std::ostream& out) const;
 	private:
 		request_handler::RequestHandler& rh_;
 
+		void ReadStatSettings(const json::Dict& dict);
 		void FillTransportCatalogue(const json::Dict& dict);
 		void FillGraphInRouter();
 		const json::Dict& FillStop(const json::Dict& stop_req);
-		void FillBus(const json::Dict& bus_req);
+		domain::Bus ReadBus(const json::Dict& bus_req) const;
+		domain::BaseDelta ReadBaseDelta(const json::Dict& dict) const;
 
-		std::tuple<BusWaitTime, BusVelocity> ReadRoutingSettings(const json::Dict& dict);
+		transport::Router::Settings ReadRoutingSettings(const json::Dict& dict);
 		renderer::RenderingSettings ReadRenderingSettings(const json::Dict& dict);
 		double GetDoubleFromNode(const json::Node& node) const;
+		json::Node CountToNode(uint64_t count) const;
 		std::vector<svg::Color> GetColorsFromArray(const json::Array& arr) const;
 		svg::Color GetColor(const json::Node& node) const;
 
-		void AnswerStatRequests(const json::Dict& dict, std::ostream& out) const;
-		json::Node OutStopStat(const std::optional<domain::StopInfo> stop_stat, int id) const;
+		// The Out* helpers and route readers query the version the batch is answered from
+		json::Node OutStopStat(const transport::Snapshot& snapshot, const std::optional<domain::StopInfo> stop_stat, int id) const;
 		json::Node OutBusStat(const std::optional<domain::BusInfo> bus_stat, int id) const;
-		json::Node OutRouteReq(const std::string_view from, const std::string_view to, int id) const;
-		json::Node OutMapReq(int id) const;
+		void WriteRouteAnswer(json::Writer& writer, const transport::RouteInfo* route_info, 
+			const transport::RouteSearchStats& stats, int id) const;
+		json::Node OutMapReq(const transport::Snapshot& snapshot, int id) const;
+		json::Node OutMetricsReq(const transport::Snapshot& snapshot, int id) const;
+		json::Node OutMemoryReq(const transport::Snapshot& snapshot, int id) const;
+		json::Dict MemoryReportToDict(const memory::Report& report) const;
+		json::Node OutNearbyStopsReq(const transport::Snapshot& snapshot, const json::Dict& req, int id) const;
+		json::Node OutSearchReq(const transport::Snapshot& snapshot, const json::Dict& req, int id) const;
+		json::Node OutDirectBusesReq(const transport::Snapshot& snapshot, const json::Dict& req, int id) const;
+		json::Node OutAnalyticsReq(const transport::Snapshot& snapshot, const json::Dict& req, int id) const;
+		json::Dict DistributionToDict(const domain::Distribution& distribution) const;
+
+		// Points into a per-thread buffer valid until the next call, nullptr if there is no route
+		const transport::RouteInfo* GetRouteInfo(const transport::Snapshot& snapshot, const json::Dict& req, transport::RouteSearchStats& stats) const;
+		std::vector<transport::SnappedStop> ReadRouteEndpoint(const transport::Snapshot& snapshot, const json::Dict& req, const std::string& key) const;
 
-		std::tuple<std::vector<std::string_view>, int, domain::StopPointer> WordsToRoute(const json::Array& words, bool is_roundtrip) const;
+		// Throws std::invalid_argument if a stop is unknown
+		std::tuple<std::vector<domain::StopId>, domain::StopView> WordsToRoute(const json::Array& words) const;
 	};
 }
@@ -7,28 +7,38 @@
 using namespace std::literals;
 
 void PrintUsage(std::ostream& stream = std::cerr) {
-    stream << "Usage: transport_catalogue [make_base|process_requests]\n"sv;
+    stream << "Usage: transport_catalogue [make_base|update_base|process_requests] [--memory-report]\n"sv;
 }
 
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
+    if (argc != 2 && argc != 3) {
+        PrintUsage();
+        return 1;
+    }
+    // Reports the memory of the built or loaded version to stderr once the mode is done
+    const bool memory_report = argc == 3 && argv[2] == "--memory-report"sv;
+    if (argc == 3 && !memory_report) {
         PrintUsage();
         return 1;
     }
 
 	renderer::MapRenderer mr;
-	transport::TransportCatalogue db;
-	request_handler::RequestHandler rh(db, mr);
+	request_handler::RequestHandler rh(mr);
 	json_reader::JsonReader js_reader(rh);
 
     const std::string_view mode(argv[1]);
     // const std::string_view mode = "process_requests"sv;
     if (mode == "make_base"sv) {
         js_reader.MakeBase(std::cin);
+    } else if (mode == "update_base"sv) {
+        js_reader.UpdateBase(std::cin);
     } else if (mode == "process_requests"sv) {
         js_reader.ProcessRequests(std::cin, std::cout);
     } else {
         PrintUsage();
         return 1;
     }
+    if (memory_report) {
+        js_reader.PrintMemoryReport(std::cerr);
+    }
 }
\ No newline at end of file
@@ -26,49 +26,34 @@ namespace renderer {
 		return settings_;
 	}
 
-	svg::Document MapRenderer::MakeDocument(std::vector<BusPointer>&& buses, std::vector<std::pair<StopPointer, StopInfo>>&& stops) const 
+	memory::Report MapRenderer::MemoryReport() const
+	{
+		return { memory::Of("color_palette", settings_.color_palette) };
+	}
+
+	svg::Document MapRenderer::MakeDocument(BusViewsByName buses, StopViewsByName stops) const 
     {
 		svg::Document result;
 
-		std::sort(
-			buses.begin(),
-			buses.end(),
-			[](const BusPointer& lhs, const BusPointer& rhs) {
-				return std::lexicographical_compare(
-					lhs.get()->name.get()->begin(), lhs.get()->name.get()->end(),
-					rhs.get()->name.get()->begin(), rhs.get()->name.get()->end()
-				);
-			}
-		);
-		std::sort(
-			stops.begin(),
-			stops.end(),
-			[](const std::pair<StopPointer, StopInfo>& lhs, const std::pair<StopPointer, StopInfo>& rhs) {
-				return std::lexicographical_compare(
-					lhs.first.get()->name.get()->begin(), lhs.first.get()->name.get()->end(),
-					rhs.first.get()->name.get()->begin(), rhs.first.get()->name.get()->end()
-				);
-			}
-		);
-
-		const auto coordinates = StopsToCoordinates(stops.begin(), stops.end());
+		const ServedStops served = ranges::Filter(stops, IsServed{});
+		const auto coordinates = ranges::Transform(served, ToCoordinates{});
 		SphereProjector projector(coordinates.begin(), coordinates.end(), settings_.width, settings_.height, settings_.padding);
 
 		AddBusesLines(result, projector, buses);
 		AddBusesNames(result, projector, buses);
-		AddStopsCircles(result, projector, stops);
-		AddStopsNames(result, projector, stops);
+		AddStopsCircles(result, projector, served);
+		AddStopsNames(result, projector, served);
 
 		return result;
 	}
 
-	void MapRenderer::AddBusesLines(svg::Document& doc, SphereProjector& proj, const std::vector<BusPointer>& buses) const 
+	void MapRenderer::AddBusesLines(svg::Document& doc, SphereProjector& proj, BusViewsByName buses) const 
     {
 		size_t color = 0u;
 		size_t palette_size = settings_.color_palette.size();
-		for (const BusPointer& bus : buses) 
+		for (const BusView bus : buses) 
         {
-			if (bus.get()->route.empty()) 
+			if (bus.Route().empty()) 
             {
 				continue;
 			}
@@ -82,34 +67,32 @@ namespace renderer {
 
 			color = ((color == palette_size) ? 0u : color);
 
-			for (const auto& stop_ptr : bus.get()->route) 
+			for (size_t i = 0u; i < bus.Route().size(); ++i) 
             {
-				const auto& stop = *stop_ptr.get();
-				polyline.AddPoint(proj({ stop.coords.lat, stop.coords.lng }));
+				polyline.AddPoint(proj(bus.RouteStop(i).Coords()));
 			}
 			doc.Add(std::move(polyline));
 		}
 	}
 
-	void MapRenderer::AddBusesNames(svg::Document& doc, SphereProjector& proj, const std::vector<BusPointer>& buses) const 
+	void MapRenderer::AddBusesNames(svg::Document& doc, SphereProjector& proj, BusViewsByName buses) const 
     {
 		size_t color = 0u;
 		size_t palette_size = settings_.color_palette.size();
-		for (const BusPointer& BusPointer : buses) 
+		for (const BusView bus : buses) 
         {
-			const auto& bus = *BusPointer.get();
-			if (bus.route.empty()) 
+			if (bus.Route().empty()) 
             {
 				continue;
 			}
 			svg::Text text;
 			text
-				.SetPosition(proj({ bus.route[0u].get()->coords.lat, bus.route[0u].get()->coords.lng }))
+				.SetPosition(proj(bus.RouteStop(0u).Coords()))
 				.SetOffset(settings_.bus_label_offset)
 				.SetFontSize(settings_.bus_label_font_size)
 				.SetFontFamily("Verdana"s)
 				.SetFontWeight("bold"s)
-				.SetData(*bus.name.get());
+				.SetData(std::string(bus.Name()));
 
 			svg::Text text_substrate = text;
 			text_substrate
@@ -130,9 +113,9 @@ namespace renderer {
 			doc.Add(std::move(text_substrate));
 			doc.Add(std::move(text));
 
-			if (bus.last_stop != nullptr && bus.last_stop.get() != bus.route.front().get()) 
+			if (bus.LastStop() && bus.LastStop() != bus.RouteStop(0u)) 
             {
-				svg::Point p = proj({ bus.last_stop.get()->coords.lat, bus.last_stop.get()->coords.lng });
+				svg::Point p = proj(bus.LastStop().Coords());
 
 				text_substrate_last_stop
 					.SetPosition(p);
@@ -147,23 +130,13 @@ namespace renderer {
 		}
 	}
 
-	void MapRenderer::AddStopsCircles(svg::Document& doc, SphereProjector& proj, const std::vector<std::pair<StopPointer, StopInfo>>& stops) const 
+	void MapRenderer::AddStopsCircles(svg::Document& doc, SphereProjector& proj, ServedStops stops) const 
     {
-		for (const auto& [stop_ptr, stop_stat] : stops) 
+		for (const StopView stop : stops) 
         {
-			const auto& stop = *stop_ptr.get();
-			if (stop_stat.passing_buses == nullptr) 
-            {
-				continue;
-			}
-			else if (stop_stat.passing_buses->empty()) 
-            {
-				continue;
-			}
-
 			svg::Circle circle;
 			circle
-				.SetCenter(proj({ stop.coords.lat, stop.coords.lng }))
+				.SetCenter(proj(stop.Coords()))
 				.SetRadius(settings_.stop_radius)
 				.SetFillColor("white"s);
 
@@ -171,27 +144,17 @@ namespace renderer {
 		}
 	}
 
-	void MapRenderer::AddStopsNames(svg::Document& doc, SphereProjector& proj, const std::vector<std::pair<StopPointer, StopInfo>>& stops) const 
+	void MapRenderer::AddStopsNames(svg::Document& doc, SphereProjector& proj, ServedStops stops) const 
     {
-		for (const auto& [stop_ptr, stop_stat] : stops) 
+		for (const StopView stop : stops) 
         {
-			const auto& stop = *stop_ptr.get();
-			if (stop_stat.passing_buses == nullptr) 
-            {
-				continue;
-			}
-			else if (stop_stat.passing_buses->empty()) 
-            {
-				continue;
-			}
-
 			svg::Text text;
 			text
-				.SetPosition(proj({ stop.coords.lat, stop.coords.lng }))
+				.SetPosition(proj(stop.Coords()))
 				.SetOffset(settings_.stop_label_offset)
 				.SetFontSize(settings_.stop_label_font_size)
 				.SetFontFamily("Verdana"s)
-				.SetData(*stop.name.get());
+				.SetData(std::string(stop.Name()));
 
 			svg::Text text_substrate = text;
 			text_substrate
@@ -3,6 +3,7 @@
 #include "svg.h"
 #include "domain.h"
 #include "geo.h"
+#include "memory_report.h"
 
 #include <vector>
 #include <memory>
@@ -29,8 +30,8 @@ namespace renderer
 					return lhs.lng < rhs.lng;
 				}
 			);
-			min_lon_ = left_it->lng;
-			const double max_lon = right_it->lng;
+			min_lon_ = (*left_it).lng;
+			const double max_lon = (*right_it).lng;
 
 			const auto [bottom_it, top_it] = std::minmax_element(
 				points_begin,
@@ -39,8 +40,8 @@ namespace renderer
 					return lhs.lat < rhs.lat;
 				}
 			);
-			const double min_lat = bottom_it->lat;
-			max_lat_ = top_it->lat;
+			const double min_lat = (*bottom_it).lat;
+			max_lat_ = (*top_it).lat;
 
 			std::optional<double> width_zoom;
 			if (!IsZero(max_lon - min_lon_)) 
@@ -108,30 +109,27 @@ namespace renderer
 		MapRenderer(RenderingSettings&& settings);
 
 		void SetSettings(RenderingSettings&& settings);
-		svg::Document MakeDocument(std::vector<domain::BusPointer>&& buses, std::vector<std::pair<domain::StopPointer, domain::StopInfo>>&& stops) const;
+		// Buses and stops are drawn in name order; stops no bus passes are left out
+		svg::Document MakeDocument(domain::BusViewsByName buses, domain::StopViewsByName stops) const;
 
 		const RenderingSettings& GetRenderSettings() const;
+		memory::Report MemoryReport() const;
 	private:
 		RenderingSettings settings_;
 
-		template <typename It>
-		std::vector<geo::Coordinates> StopsToCoordinates(It begin, It end) const 
+		struct IsServed 
         {
-			std::vector<geo::Coordinates> result;
-			result.reserve(end - begin);
-			for (It it = begin; it != end; ++it) 
-            {
-				if (it->second.passing_buses != nullptr && !it->second.passing_buses->empty()) 
-                {
-					result.emplace_back(geo::Coordinates{ it->first.get()->coords.lat, it->first.get()->coords.lng });
-				}
-			}
-			return result;
-		}
-
-		void AddBusesLines(svg::Document& doc, SphereProjector& proj, const std::vector<domain::BusPointer>& buses) const;
-		void AddBusesNames(svg::Document& doc, SphereProjector& proj, const std::vector<domain::BusPointer>& buses) const;
-		void AddStopsCircles(svg::Document& doc, SphereProjector& proj, const std::vector<std::pair<domain::StopPointer, domain::StopInfo>>& stops) const;
-		void AddStopsNames(svg::Document& doc, SphereProjector& proj, const std::vector<std::pair<domain::StopPointer, domain::StopInfo>>& stops) const;
+			bool operator()(const domain::StopView& stop) const { return !stop.PassingBuses().empty(); }
+		};
+		struct ToCoordinates 
+        {
+			geo::Coordinates operator()(const domain::StopView& stop) const { return stop.Coords(); }
+		};
+		using ServedStops = ranges::Range<ranges::FilteredIterator<domain::StopViewsByName::Iterator, IsServed>>;
+
+		void AddBusesLines(svg::Document& doc, SphereProjector& proj, domain::BusViewsByName buses) const;
+		void AddBusesNames(svg::Document& doc, SphereProjector& proj, domain::BusViewsByName buses) const;
+		void AddStopsCircles(svg::Document& doc, SphereProjector& proj, ServedStops stops) const;
+		void AddStopsNames(svg::Document& doc, SphereProjector& proj, ServedStops stops) const;
 	};
 }
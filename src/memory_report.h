@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace memory
+{
+	// One internal container: the heap bytes it holds (its capacity, not its size) and its element count
+	struct Entry
+	{
+		std::string name;
+		size_t bytes = 0u;
+		size_t count = 0u;
+	};
+	using Report = std::vector<Entry>;
+
+	template <typename T>
+	size_t HeapBytes(const std::vector<T>& values)
+	{
+		return values.capacity() * sizeof(T);
+	}
+
+	inline size_t HeapBytes(const std::vector<bool>& values)
+	{
+		return values.capacity() / 8u;
+	}
+
+	template <typename T>
+	size_t HeapBytes(const std::vector<std::vector<T>>& values)
+	{
+		size_t bytes = values.capacity() * sizeof(std::vector<T>);
+		for (const auto& inner : values)
+		{
+			bytes += HeapBytes(inner);
+		}
+		return bytes;
+	}
+
+	inline size_t HeapBytes(const std::string& chars)
+	{
+		return chars.capacity();
+	}
+
+	template <typename Container>
+	Entry Of(std::string name, const Container& container)
+	{
+		return { std::move(name), HeapBytes(container), container.size() };
+	}
+
+	// Appends the entries of a part, their names prefixed with "<prefix>."
+	inline void Append(Report& report, const std::string& prefix, Report&& part)
+	{
+		for (Entry& entry : part)
+		{
+			entry.name = prefix + "." + entry.name;
+			report.push_back(std::move(entry));
+		}
+	}
+
+	inline size_t TotalBytes(const Report& report)
+	{
+		size_t bytes = 0u;
+		for (const Entry& entry : report)
+		{
+			bytes += entry.bytes;
+		}
+		return bytes;
+	}
+}
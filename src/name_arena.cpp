@@ -0,0 +1,169 @@
+#include "name_arena.h"
+
+#include <algorithm>
+#include <functional>
+#include <numeric>
+
+namespace domain
+{
+	NameArena::NameId NameArena::Add(std::string_view name)
+	{
+		if (hashes_.size() != Size())
+		{
+			RebuildTable();
+		}
+
+		const NameId id = static_cast<NameId>(Size());
+		chars_.append(name);
+		offsets_.push_back(static_cast<uint32_t>(chars_.size()));
+		hashes_.push_back(std::hash<std::string_view>{}(name));
+
+		if (hashes_.size() * 2u > slots_.size())
+		{
+			Grow();
+		}
+		slots_[FindSlot(name, hashes_.back())] = id;
+		return id;
+	}
+
+	NameArena::NameId NameArena::AddStored(std::string_view name)
+	{
+		const NameId id = static_cast<NameId>(Size());
+		chars_.append(name);
+		offsets_.push_back(static_cast<uint32_t>(chars_.size()));
+		return id;
+	}
+
+	std::optional<NameArena::NameId> NameArena::Find(std::string_view name) const
+	{
+		if (!perfect_hash_.Empty())
+		{
+			const NameId id = perfect_hash_.Find(PerfectHash::Hash(name));
+			return (Get(id) == name) ? std::optional<NameId>(id) : std::nullopt;
+		}
+		if (slots_.empty()) { return std::nullopt; }
+
+		const uint32_t id = slots_[FindSlot(name, std::hash<std::string_view>{}(name))];
+		return (id != EMPTY_SLOT) ? std::optional<NameId>(id) : std::nullopt;
+	}
+
+	void NameArena::BuildPerfectHash()
+	{
+		if (!perfect_hash_.Empty() || Size() == 0u) { return; }
+
+		std::vector<uint64_t> hashes;
+		hashes.reserve(Size());
+		for (NameId id = 0u; id < Size(); ++id)
+		{
+			hashes.push_back(PerfectHash::Hash(Get(id)));
+		}
+		if (!perfect_hash_.Build(hashes))
+		{
+			RebuildTable();
+			return;
+		}
+		hashes_ = {};
+		slots_ = {};
+	}
+
+	void NameArena::RestorePerfectHash(std::optional<PerfectHash::Layout>&& layout)
+	{
+		if (layout && perfect_hash_.Restore(Size(), std::move(*layout)) && CheckPerfectHash())
+		{
+			hashes_ = {};
+			slots_ = {};
+			return;
+		}
+		perfect_hash_ = {};
+		BuildPerfectHash();
+	}
+
+	PerfectHash::Layout NameArena::GetPerfectHashLayout() const
+	{
+		return perfect_hash_.GetLayout();
+	}
+
+	size_t NameArena::Size() const
+	{
+		return offsets_.size() - 1u;
+	}
+
+	memory::Report NameArena::MemoryReport() const
+	{
+		memory::Report report = {
+			memory::Of("chars", chars_),
+			memory::Of("offsets", offsets_),
+			memory::Of("hashes", hashes_),
+			memory::Of("slots", slots_)
+		};
+		memory::Append(report, "perfect_hash", perfect_hash_.MemoryReport());
+		return report;
+	}
+
+	std::vector<NameArena::NameId> NameArena::MakeSortedOrder() const
+	{
+		std::vector<NameId> order(Size());
+		std::iota(order.begin(), order.end(), 0u);
+		std::sort(order.begin(), order.end(), [this](NameId lhs, NameId rhs) {
+			const std::string_view lhs_name = Get(lhs);
+			const std::string_view rhs_name = Get(rhs);
+			return std::lexicographical_compare(lhs_name.begin(), lhs_name.end(), rhs_name.begin(), rhs_name.end());
+		});
+		return order;
+	}
+
+	size_t NameArena::FindSlot(std::string_view name, size_t hash) const
+	{
+		// slots_.size() is a power of two
+		const size_t mask = slots_.size() - 1u;
+		for (size_t slot = hash & mask; ; slot = (slot + 1u) & mask)
+		{
+			const uint32_t id = slots_[slot];
+			if (id == EMPTY_SLOT || (hashes_[id] == hash && Get(id) == name))
+			{
+				return slot;
+			}
+		}
+	}
+
+	void NameArena::RebuildTable()
+	{
+		perfect_hash_ = {};
+		hashes_.clear();
+		hashes_.reserve(Size());
+		for (NameId id = 0u; id < Size(); ++id)
+		{
+			hashes_.push_back(std::hash<std::string_view>{}(Get(id)));
+		}
+		size_t slot_count = 16u;
+		while (slot_count < hashes_.size() * 2u)
+		{
+			slot_count *= 2u;
+		}
+		slots_.assign(slot_count, EMPTY_SLOT);
+		// Newer ids overwrite older ones with the same name
+		for (NameId id = 0u; id < hashes_.size(); ++id)
+		{
+			slots_[FindSlot(Get(id), hashes_[id])] = id;
+		}
+	}
+
+	bool NameArena::CheckPerfectHash() const
+	{
+		for (NameId id = 0u; id < Size(); ++id)
+		{
+			if (perfect_hash_.Find(PerfectHash::Hash(Get(id))) != id) { return false; }
+		}
+		return true;
+	}
+
+	void NameArena::Grow()
+	{
+		slots_.assign(std::max<size_t>(16u, slots_.size() * 2u), EMPTY_SLOT);
+		// Newer ids overwrite older ones with the same name
+		for (NameId id = 0u; id + 1u < hashes_.size(); ++id)
+		{
+			slots_[FindSlot(Get(id), hashes_[id])] = id;
+		}
+	}
+}
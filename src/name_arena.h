@@ -0,0 +1,71 @@
+#pragma once
+
+#include "memory_report.h"
+#include "perfect_hash.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace domain
+{
+	// Names stored back to back in one character buffer, addressed by dense ids
+	// given in insertion order. Views returned by Get stay valid until the next Add.
+	// While names are being added they are looked up in a growable hash table; once they
+	// are all there the table can give way to a minimal perfect hash, kept with the base
+	class NameArena
+	{
+	public:
+		using NameId = uint32_t;
+
+		// Appends the name even if it is already stored; Find then returns the newest id.
+		// Drops the perfect hash if there is one
+		NameId Add(std::string_view name);
+		// Appends a name read back from a base, where names are distinct, without indexing it:
+		// Find misses it until RestorePerfectHash
+		NameId AddStored(std::string_view name);
+		std::optional<NameId> Find(std::string_view name) const;
+
+		// Replaces the growable table by a perfect hash over the names, so that Find is one probe
+		// and one compare. Kept on the table if two names are equal
+		void BuildPerfectHash();
+		// Takes a layout made by GetPerfectHashLayout for the same names; if it does not fit them
+		// (or there is none), the perfect hash is built anew
+		void RestorePerfectHash(std::optional<PerfectHash::Layout>&& layout);
+		// Empty if the names are looked up in the growable table
+		PerfectHash::Layout GetPerfectHashLayout() const;
+
+		std::string_view Get(NameId id) const
+		{
+			return { chars_.data() + offsets_[id], offsets_[id + 1u] - offsets_[id] };
+		}
+		size_t Size() const;
+
+		// Ids ordered by name, as std::lexicographical_compare orders the characters
+		std::vector<NameId> MakeSortedOrder() const;
+
+		memory::Report MemoryReport() const;
+
+	private:
+		static constexpr uint32_t EMPTY_SLOT = UINT32_MAX;
+
+		std::string chars_;
+		std::vector<uint32_t> offsets_ = { 0u };    // name i is [offsets_[i], offsets_[i + 1])
+
+		// Open addressing over name ids with linear probing, at most half full;
+		// both empty while the perfect hash is in use
+		std::vector<size_t> hashes_;                // per name, reused when the table grows
+		std::vector<uint32_t> slots_;
+
+		PerfectHash perfect_hash_;
+
+		size_t FindSlot(std::string_view name, size_t hash) const;
+		void Grow();
+		// Back from the perfect hash (or unindexed names) to the growable table
+		void RebuildTable();
+		// Whether every name is found under its own id
+		bool CheckPerfectHash() const;
+	};
+}
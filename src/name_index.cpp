@@ -0,0 +1,186 @@
+#include "name_index.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace domain
+{
+	namespace
+	{
+		bool IsContinuationByte(char c)
+		{
+			return (static_cast<unsigned char>(c) & 0xC0u) == 0x80u;
+		}
+
+		// One past the UTF-8 character starting at pos; stray continuation bytes stick to the character before
+		size_t NextCharEnd(std::string_view text, size_t pos)
+		{
+			++pos;
+			while (pos < text.size() && IsContinuationByte(text[pos]))
+			{
+				++pos;
+			}
+			return pos;
+		}
+	}
+
+	void NameIndex::Build(const NameArena& names)
+	{
+		order_ = names.MakeSortedOrder();
+		ComputeCommonPrefixes(names);
+	}
+
+	bool NameIndex::Restore(const NameArena& names, std::vector<NameId>&& order)
+	{
+		bool fits = (order.size() == names.Size());
+		std::vector<bool> seen(names.Size(), false);
+		for (size_t i = 0u; fits && i < order.size(); ++i)
+		{
+			fits = (order[i] < names.Size() && !seen[order[i]]);
+			if (fits)
+			{
+				seen[order[i]] = true;
+			}
+		}
+
+		order_ = std::move(order);
+		if (!fits || !ComputeCommonPrefixes(names))
+		{
+			order_.clear();
+			common_prefixes_.clear();
+			return false;
+		}
+		return true;
+	}
+
+	const std::vector<NameArena::NameId>& NameIndex::Order() const
+	{
+		return order_;
+	}
+
+	memory::Report NameIndex::MemoryReport() const
+	{
+		return { memory::Of("order", order_), memory::Of("common_prefixes", common_prefixes_) };
+	}
+
+	ranges::Range<const NameArena::NameId*> NameIndex::FindPrefix(const NameArena& names, std::string_view prefix) const
+	{
+		const NameId* begin = order_.data();
+		const NameId* end = begin + order_.size();
+		const NameId* first = std::lower_bound(begin, end, prefix, [&names](NameId id, std::string_view value) {
+			const std::string_view name = names.Get(id);
+			return std::lexicographical_compare(name.begin(), name.end(), value.begin(), value.end());
+		});
+		const NameId* last = std::partition_point(first, end, [&names, prefix](NameId id) {
+			return names.Get(id).substr(0u, prefix.size()) == prefix;
+		});
+		return { first, last };
+	}
+
+	std::vector<NameArena::NameId> NameIndex::FindSimilar(const NameArena& names, std::string_view query, size_t max_edits, bool as_prefix) const
+	{
+		if (as_prefix && max_edits == 0u)
+		{
+			const auto run = FindPrefix(names, query);
+			return { run.begin(), run.end() };
+		}
+
+		std::vector<std::string_view> query_chars;
+		for (size_t pos = 0u; pos < query.size(); )
+		{
+			const size_t end = NextCharEnd(query, pos);
+			query_chars.push_back(query.substr(pos, end - pos));
+			pos = end;
+		}
+		const size_t width = query_chars.size() + 1u;
+
+		// Levenshtein rows along the walk down the implicit trie: row k holds the distances from
+		// the first k characters of the current name to every prefix of the query and ends at
+		// byte row_ends[k]. best[k] is the least distance to the whole query over rows 0..k
+		std::vector<size_t> rows(width);
+		std::iota(rows.begin(), rows.end(), size_t{ 0u });
+		std::vector<size_t> row_ends = { 0u };
+		std::vector<size_t> best = { query_chars.size() };
+
+		std::vector<NameId> result;
+		for (size_t i = 0u; i < order_.size(); )
+		{
+			const std::string_view name = names.Get(order_[i]);
+			// Rows of the prefix shared with the last name walked stay valid
+			while (row_ends.size() > 1u && (row_ends.back() > common_prefixes_[i]
+				|| (row_ends.back() < name.size() && IsContinuationByte(name[row_ends.back()]))))
+			{
+				row_ends.pop_back();
+				best.pop_back();
+			}
+			rows.resize(row_ends.size() * width);
+
+			// Decided once no name under the current row can match, or with as_prefix once all of them do
+			bool decided = as_prefix && best.back() <= max_edits;
+			for (size_t pos = row_ends.back(); pos < name.size() && !decided; )
+			{
+				const size_t end = NextCharEnd(name, pos);
+				const std::string_view name_char = name.substr(pos, end - pos);
+				const size_t prev = rows.size() - width;
+				const size_t cur = rows.size();
+				rows.resize(rows.size() + width);
+
+				rows[cur] = rows[prev] + 1u;
+				size_t row_min = rows[cur];
+				for (size_t j = 1u; j < width; ++j)
+				{
+					const size_t substitution = rows[prev + j - 1u] + (name_char == query_chars[j - 1u] ? 0u : 1u);
+					rows[cur + j] = std::min({ rows[prev + j] + 1u, rows[cur + j - 1u] + 1u, substitution });
+					row_min = std::min(row_min, rows[cur + j]);
+				}
+				row_ends.push_back(end);
+				best.push_back(std::min(best.back(), rows[cur + width - 1u]));
+				pos = end;
+
+				decided = row_min > max_edits || (as_prefix && best.back() <= max_edits);
+			}
+
+			if (decided)
+			{
+				// Names sharing the bytes walked so far follow name i as one run
+				size_t run_end = i + 1u;
+				while (run_end < order_.size() && common_prefixes_[run_end] >= row_ends.back())
+				{
+					++run_end;
+				}
+				if (as_prefix && best.back() <= max_edits)
+				{
+					result.insert(result.end(), order_.begin() + i, order_.begin() + run_end);
+				}
+				i = run_end;
+			}
+			else
+			{
+				if (!as_prefix && rows.back() <= max_edits)
+				{
+					result.push_back(order_[i]);
+				}
+				++i;
+			}
+		}
+		return result;
+	}
+
+	bool NameIndex::ComputeCommonPrefixes(const NameArena& names)
+	{
+		common_prefixes_.assign(order_.size(), 0u);
+		for (size_t i = 1u; i < order_.size(); ++i)
+		{
+			const std::string_view prev = names.Get(order_[i - 1u]);
+			const std::string_view cur = names.Get(order_[i]);
+			const auto [prev_it, cur_it] = std::mismatch(prev.begin(), prev.end(), cur.begin(), cur.end());
+			// cur must not order before prev
+			if (prev_it != prev.end() && (cur_it == cur.end() || *cur_it < *prev_it))
+			{
+				return false;
+			}
+			common_prefixes_[i] = static_cast<uint32_t>(cur_it - cur.begin());
+		}
+		return true;
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "memory_report.h"
+#include "name_arena.h"
+#include "ranges.h"
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace domain
+{
+	// Ids of a NameArena sorted by name, plus how many bytes each name shares with the previous one.
+	// That is a trie laid out flat: every subtree is a run of consecutive names,
+	// so prefix search is a binary search and fuzzy search can skip whole runs
+	class NameIndex
+	{
+	public:
+		using NameId = NameArena::NameId;
+
+		void Build(const NameArena& names);
+		// Takes an order made by Order() for the same names; false (and the index
+		// left empty) if it is not a sorted permutation of them
+		bool Restore(const NameArena& names, std::vector<NameId>&& order);
+
+		// Names as std::lexicographical_compare orders their characters
+		const std::vector<NameId>& Order() const;
+
+		// The run of Order() whose names start with `prefix`
+		ranges::Range<const NameId*> FindPrefix(const NameArena& names, std::string_view prefix) const;
+		// Names at most `max_edits` insertions, deletions or substitutions of UTF-8 characters away
+		// from `query`; with `as_prefix` it is enough for some prefix of the name to be. In name order
+		std::vector<NameId> FindSimilar(const NameArena& names, std::string_view query, size_t max_edits, bool as_prefix) const;
+
+		memory::Report MemoryReport() const;
+
+	private:
+		std::vector<NameId> order_;
+		std::vector<uint32_t> common_prefixes_;    // with the previous name in order_, 0 for the first
+
+		// Also checks that order_ is sorted
+		bool ComputeCommonPrefixes(const NameArena& names);
+	};
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace parallel
+{
+	// The hardware threads, unless the TRANSPORT_THREADS environment variable gives another
+	// positive count, e.g. to keep a shared machine's cores free or to check results do not
+	// depend on the count
+	inline size_t MaxThreads()
+	{
+		if (const char* threads = std::getenv("TRANSPORT_THREADS"))
+		{
+			if (const long count = std::strtol(threads, nullptr, 10); count > 0)
+			{
+				return static_cast<size_t>(count);
+			}
+		}
+		return std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	// Threads worth starting for `count` items: at most MaxThreads, and none for fewer than
+	// `min_per_thread` items each. Always at least one, the calling thread
+	inline size_t ThreadsFor(size_t count, size_t min_per_thread)
+	{
+		return std::min<size_t>(MaxThreads(), count / min_per_thread + 1u);
+	}
+
+	// Calls worker(thread_index) for every index below `threads`, the last one on the calling
+	// thread, and returns once all of them are done
+	template <typename Worker>
+	void Run(size_t threads, Worker&& worker)
+	{
+		std::vector<std::thread> started;
+		started.reserve(threads - 1u);
+		for (size_t i = 0u; i + 1u < threads; ++i)
+		{
+			started.emplace_back([&worker, i]() { worker(i); });
+		}
+		worker(threads - 1u);
+		for (auto& thread : started)
+		{
+			thread.join();
+		}
+	}
+}
@@ -0,0 +1,158 @@
+#include "perfect_hash.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace domain
+{
+	namespace
+	{
+		// splitmix64 finalizer
+		uint64_t Mix(uint64_t value)
+		{
+			value ^= value >> 30;
+			value *= 0xbf58476d1ce4e5b9ull;
+			value ^= value >> 27;
+			value *= 0x94d049bb133111ebull;
+			value ^= value >> 31;
+			return value;
+		}
+
+		// Maps the high half of a mixed hash onto [0, size) with a multiply instead of a division
+		size_t ReduceRange(uint64_t hash, size_t size)
+		{
+			return static_cast<size_t>(((hash >> 32) * static_cast<uint64_t>(size)) >> 32);
+		}
+
+		constexpr uint32_t NO_KEY = UINT32_MAX;
+	}
+
+	uint64_t PerfectHash::Hash(std::string_view key)
+	{
+		// FNV-1a, then mixed so that every bit depends on every byte
+		uint64_t hash = 0xcbf29ce484222325ull;
+		for (const char c : key)
+		{
+			hash ^= static_cast<unsigned char>(c);
+			hash *= 0x100000001b3ull;
+		}
+		return Mix(hash);
+	}
+
+	bool PerfectHash::Build(const std::vector<uint64_t>& keys)
+	{
+		seeds_.clear();
+		keys_.clear();
+		if (keys.empty()) { return true; }
+
+		// Equal hashes could never get slots of their own
+		std::vector<uint64_t> sorted(keys);
+		std::sort(sorted.begin(), sorted.end());
+		if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end()) { return false; }
+
+		seeds_.assign(keys.size() / AVERAGE_BUCKET_SIZE + 1u, 0u);
+		keys_.assign(keys.size(), NO_KEY);
+
+		// Keys grouped by bucket, bucket b owns [bucket_begins[b], bucket_begins[b + 1])
+		std::vector<uint32_t> bucket_begins(seeds_.size() + 1u, 0u);
+		for (const uint64_t hash : keys)
+		{
+			++bucket_begins[Bucket(hash) + 1u];
+		}
+		std::partial_sum(bucket_begins.begin(), bucket_begins.end(), bucket_begins.begin());
+		std::vector<uint32_t> bucket_keys(keys.size());
+		std::vector<uint32_t> fill(bucket_begins.begin(), bucket_begins.end() - 1);
+		for (uint32_t key = 0u; key < keys.size(); ++key)
+		{
+			bucket_keys[fill[Bucket(keys[key])]++] = key;
+		}
+
+		// Largest buckets first, while most slots are still free
+		std::vector<uint32_t> buckets(seeds_.size());
+		std::iota(buckets.begin(), buckets.end(), 0u);
+		std::stable_sort(buckets.begin(), buckets.end(), [&bucket_begins](uint32_t lhs, uint32_t rhs) {
+			return bucket_begins[lhs + 1u] - bucket_begins[lhs] > bucket_begins[rhs + 1u] - bucket_begins[rhs];
+		});
+
+		std::vector<size_t> taken;
+		for (const uint32_t bucket : buckets)
+		{
+			const uint32_t begin = bucket_begins[bucket];
+			const uint32_t end = bucket_begins[bucket + 1u];
+			if (begin == end) { break; }
+
+			// Hashes are distinct, so some seed places the bucket; the last free slots take the longest
+			for (uint32_t seed = 0u; ; ++seed)
+			{
+				taken.clear();
+				for (uint32_t i = begin; i < end; ++i)
+				{
+					const uint32_t key = bucket_keys[i];
+					const size_t slot = Slot(keys[key], seed);
+					if (keys_[slot] != NO_KEY) { break; }
+					keys_[slot] = key;
+					taken.push_back(slot);
+				}
+				if (taken.size() == end - begin)
+				{
+					seeds_[bucket] = seed;
+					break;
+				}
+				for (const size_t slot : taken)
+				{
+					keys_[slot] = NO_KEY;
+				}
+			}
+		}
+		return true;
+	}
+
+	bool PerfectHash::Restore(size_t size, Layout&& layout)
+	{
+		seeds_.clear();
+		keys_.clear();
+		if (size == 0u) { return layout.keys.empty(); }
+
+		if (layout.keys.size() != size || layout.seeds.size() != size / AVERAGE_BUCKET_SIZE + 1u) { return false; }
+		if (std::any_of(layout.keys.begin(), layout.keys.end(), [size](uint32_t key) { return key >= size; })) { return false; }
+
+		seeds_ = std::move(layout.seeds);
+		keys_ = std::move(layout.keys);
+		return true;
+	}
+
+	PerfectHash::Layout PerfectHash::GetLayout() const
+	{
+		return { seeds_, keys_ };
+	}
+
+	bool PerfectHash::Empty() const
+	{
+		return keys_.empty();
+	}
+
+	size_t PerfectHash::Size() const
+	{
+		return keys_.size();
+	}
+
+	uint32_t PerfectHash::Find(uint64_t hash) const
+	{
+		return keys_[Slot(hash, seeds_[Bucket(hash)])];
+	}
+
+	memory::Report PerfectHash::MemoryReport() const
+	{
+		return { memory::Of("seeds", seeds_), memory::Of("keys", keys_) };
+	}
+
+	size_t PerfectHash::Bucket(uint64_t hash) const
+	{
+		return ReduceRange(hash, seeds_.size());
+	}
+
+	size_t PerfectHash::Slot(uint64_t hash, uint32_t seed) const
+	{
+		return ReduceRange(Mix(hash + (seed + 1ull) * 0x9e3779b97f4a7c15ull), keys_.size());
+	}
+}
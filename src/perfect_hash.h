@@ -0,0 +1,51 @@
+#pragma once
+
+#include "memory_report.h"
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace domain
+{
+	// Minimal perfect hash over a fixed set of distinct keys, by hash and displace: keys are
+	// spread over small buckets, and each bucket keeps the seed that sends all its keys to slots
+	// no other key took. Every key then has a slot of its own in [0, Size()), found in one probe
+	class PerfectHash
+	{
+	public:
+		// Stored with the base, so it does not depend on the standard library's std::hash
+		static uint64_t Hash(std::string_view key);
+
+		// Everything Build derives from the keys, so a stored hash can be restored as is
+		struct Layout
+		{
+			std::vector<uint32_t> seeds;    // per bucket
+			std::vector<uint32_t> keys;     // per slot, the key's position in Build's input
+		};
+
+		// keys[i] is the Hash of key i; false (and the hash left empty) if two of them are equal
+		bool Build(const std::vector<uint64_t>& keys);
+		// Takes a layout made by GetLayout over `size` keys; false (and the hash left empty)
+		// if its shape does not fit. Whether it was made for the same keys is the caller's check
+		bool Restore(size_t size, Layout&& layout);
+		Layout GetLayout() const;
+
+		bool Empty() const;
+		size_t Size() const;
+
+		// Position of the key with this hash, if it was built in; any position otherwise
+		uint32_t Find(uint64_t hash) const;
+
+		memory::Report MemoryReport() const;
+
+	private:
+		static constexpr size_t AVERAGE_BUCKET_SIZE = 4u;
+
+		std::vector<uint32_t> seeds_;
+		std::vector<uint32_t> keys_;
+
+		size_t Bucket(uint64_t hash) const;
+		size_t Slot(uint64_t hash, uint32_t seed) const;
+	};
+}
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstddef>
 #include <iterator>
+#include <type_traits>
 #include <string_view>
 #include <unordered_map>
 #include <unordered_set>
@@ -10,6 +12,7 @@ namespace ranges {
 template <typename It>
 class Range {
 public:
+    using Iterator = It;
     using ValueType = typename std::iterator_traits<It>::value_type;
 
     Range(It begin, It end)
@@ -22,6 +25,12 @@ public:
     It end() const {
         return end_;
     }
+    size_t size() const {
+        return static_cast<size_t>(std::distance(begin_, end_));
+    }
+    bool empty() const {
+        return begin_ == end_;
+    }
 
 private:
     It begin_;
@@ -33,4 +42,146 @@ auto AsRange(const C& container) {
     return Range{container.begin(), container.end()};
 }
 
+// Iterator over consecutive values, such as all dense ids in order
+template <typename T>
+class CountingIterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T*;
+    using reference = T;
+
+    CountingIterator() = default;
+    explicit CountingIterator(T value)
+        : value_(value) {
+    }
+    T operator*() const {
+        return value_;
+    }
+    CountingIterator& operator++() {
+        ++value_;
+        return *this;
+    }
+    CountingIterator operator++(int) {
+        CountingIterator old = *this;
+        ++value_;
+        return old;
+    }
+    bool operator==(const CountingIterator& other) const {
+        return value_ == other.value_;
+    }
+    bool operator!=(const CountingIterator& other) const {
+        return value_ != other.value_;
+    }
+
+private:
+    T value_{};
+};
+
+template <typename T>
+Range<CountingIterator<T>> Iota(T begin, T end) {
+    return {CountingIterator<T>(begin), CountingIterator<T>(end)};
+}
+
+// Iterator yielding map(*it) on dereference, so a range of values made from another range
+// needs no container of its own
+template <typename It, typename Map>
+class MappedIterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::decay_t<std::invoke_result_t<const Map&, typename std::iterator_traits<It>::reference>>;
+    using difference_type = typename std::iterator_traits<It>::difference_type;
+    using pointer = const value_type*;
+    using reference = value_type;
+
+    MappedIterator() = default;
+    MappedIterator(It it, Map map)
+        : it_(it)
+        , map_(map) {
+    }
+    value_type operator*() const {
+        return map_(*it_);
+    }
+    MappedIterator& operator++() {
+        ++it_;
+        return *this;
+    }
+    MappedIterator operator++(int) {
+        MappedIterator old = *this;
+        ++it_;
+        return old;
+    }
+    bool operator==(const MappedIterator& other) const {
+        return it_ == other.it_;
+    }
+    bool operator!=(const MappedIterator& other) const {
+        return it_ != other.it_;
+    }
+
+private:
+    It it_{};
+    Map map_{};
+};
+
+template <typename It, typename Map>
+Range<MappedIterator<It, Map>> Transform(Range<It> range, Map map) {
+    return {MappedIterator<It, Map>(range.begin(), map), MappedIterator<It, Map>(range.end(), map)};
+}
+
+// Iterator skipping the elements `pred` rejects
+template <typename It, typename Pred>
+class FilteredIterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = typename std::iterator_traits<It>::value_type;
+    using difference_type = typename std::iterator_traits<It>::difference_type;
+    using pointer = typename std::iterator_traits<It>::pointer;
+    using reference = typename std::iterator_traits<It>::reference;
+
+    FilteredIterator() = default;
+    FilteredIterator(It it, It end, Pred pred)
+        : it_(it)
+        , end_(end)
+        , pred_(pred) {
+        Skip();
+    }
+    reference operator*() const {
+        return *it_;
+    }
+    FilteredIterator& operator++() {
+        ++it_;
+        Skip();
+        return *this;
+    }
+    FilteredIterator operator++(int) {
+        FilteredIterator old = *this;
+        ++*this;
+        return old;
+    }
+    bool operator==(const FilteredIterator& other) const {
+        return it_ == other.it_;
+    }
+    bool operator!=(const FilteredIterator& other) const {
+        return it_ != other.it_;
+    }
+
+private:
+    It it_{};
+    It end_{};
+    Pred pred_{};
+
+    void Skip() {
+        while (it_ != end_ && !pred_(*it_)) {
+            ++it_;
+        }
+    }
+};
+
+template <typename It, typename Pred>
+Range<FilteredIterator<It, Pred>> Filter(Range<It> range, Pred pred) {
+    return {FilteredIterator<It, Pred>(range.begin(), range.end(), pred),
+            FilteredIterator<It, Pred>(range.end(), range.end(), pred)};
+}
+
 }  // namespace ranges
\ No newline at end of file
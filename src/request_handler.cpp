@@ -1,5 +1,7 @@
 #include "request_handler.h"
 
+#include <stdexcept>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 #include <utility>
@@ -7,20 +9,39 @@
 
 namespace request_handler {
 	using namespace domain;
+	using namespace std::literals;
 
-	RequestHandler::RequestHandler(transport::TransportCatalogue& db, renderer::MapRenderer& mr) : db_(db), mr_(mr), sz_(db, mr) 
+	RequestHandler::RequestHandler(renderer::MapRenderer& mr) : mr_(mr), draft_(std::make_shared<transport::Snapshot>()) 
 	{
-		sz_.SetTransportRouter(rt_);
 	}
 
 	void RequestHandler::AddBus(Bus&& bus) 
     {
-		db_.AddBus(std::move(bus));
+		Draft().catalogue.AddBus(std::move(bus));
+	}
+
+	void RequestHandler::AddBuses(std::vector<Bus>&& buses) 
+    {
+		auto& db = Draft().catalogue;
+		db.ComputeBusStats(buses, length_mode_);
+		for (Bus& bus : buses) 
+        {
+			db.AddBus(std::move(bus));
+		}
 	}
 
 	void RequestHandler::AddStop(Stop&& stop) 
     {
-		db_.AddStop(std::move(stop));
+		Draft().catalogue.AddStop(std::move(stop));
+	}
+
+	void RequestHandler::BuildCatalogueIndexes() 
+    {
+		auto& db = Draft().catalogue;
+		// Recorded with the finished catalogue rather than with its buses, so that a base without
+		// buses keeps the mode for the buses an update adds
+		db.SetGeographicLengthMode(length_mode_);
+		db.BuildIndexes();
 	}
 
 	void RequestHandler::SetDistanceBetweenStops(const std::string_view raw_query) 
@@ -32,117 +53,99 @@ namespace request_handler {
 			auto [raw_distance, stop_To] = SplitIntoLengthStop(move(parts[i]));
 			double distance = std::stod(move(raw_distance.substr(0u, raw_distance.size() - 1u)));
 
-			db_.SetDistanceBetweenStops(stop_X, stop_To, distance);
+			Draft().catalogue.SetDistanceBetweenStops(stop_X, stop_To, distance);
 		}
 	}
 
 	void RequestHandler::SetDistanceBetweenStops(const std::string_view first, 
             const std::string_view second, double distance) 
     {
-		db_.SetDistanceBetweenStops(first, second, distance);
+		Draft().catalogue.SetDistanceBetweenStops(first, second, distance);
 	}
 
-	BusPointer RequestHandler::FindBus(const std::string_view name) const 
+	StopView RequestHandler::FindStop(const std::string_view name) const 
     {
-		return db_.FindBus(name);
+		return Draft().catalogue.FindStop(name);
 	}
 
-	StopPointer RequestHandler::FindStop(const std::string_view name) const 
+	BusView RequestHandler::FindBus(const transport::Snapshot& snapshot, const std::string_view name) const 
     {
-		return db_.FindStop(name);
+		return snapshot.catalogue.FindBus(name);
 	}
 
-	const std::vector<BusPointer> RequestHandler::GetBusesInVector() const 
+	StopView RequestHandler::FindStop(const transport::Snapshot& snapshot, const std::string_view name) const 
     {
-		return db_.GetBusesInVector();
+		return snapshot.catalogue.FindStop(name);
 	}
 
-	const std::vector<StopPointer> RequestHandler::GetStopsInVector() const 
+	std::string_view RequestHandler::GetBusName(const transport::Snapshot& snapshot, BusId bus) const 
     {
-		return db_.GetStopsInVector();
+		return snapshot.catalogue.GetBus(bus).Name();
 	}
 
-	std::optional<BusInfo> RequestHandler::GetBusInfo(const std::string_view bus_name) const 
+	StopViews RequestHandler::GetStops(const transport::Snapshot& snapshot) const 
     {
-		BusPointer bus = db_.FindBus(bus_name);
-		if (bus == nullptr) { return {}; }
+		return snapshot.catalogue.GetStops();
+	}
+
+	BusViews RequestHandler::GetBuses(const transport::Snapshot& snapshot) const 
+    {
+		return snapshot.catalogue.GetBuses();
+	}
+
+	std::optional<BusInfo> RequestHandler::GetBusInfo(const transport::Snapshot& snapshot, const std::string_view bus_name) const 
+    {
+		const BusView bus = snapshot.catalogue.FindBus(bus_name);
+		if (!bus) { return {}; }
 
 		return std::optional<BusInfo>({
 			bus_name,
-			static_cast<int>(bus.get()->route.size()),
-			bus->unique_stops,
-			bus->route_actual_length,
-			bus->route_actual_length / bus->route_geographic_length
+			static_cast<int>(bus.Route().size()),
+			bus.UniqueStops(),
+			bus.RouteActualLength(),
+			bus.RouteActualLength() / bus.RouteGeographicLength()
 		});
 	}
 
-	std::optional<StopInfo> RequestHandler::GetStopInfo(const std::string_view stop_name) const 
+	std::optional<StopInfo> RequestHandler::GetStopInfo(const transport::Snapshot& snapshot, const std::string_view stop_name) const 
     {
-		StopPointer stop = db_.FindStop(stop_name);
-		if (stop == nullptr) { return {}; }
+		const StopView stop = snapshot.catalogue.FindStop(stop_name);
+		if (!stop) { return {}; }
 
 		return std::optional<StopInfo>({
 			stop_name,
-			GetBusesByStop(stop_name)
+			snapshot.catalogue.GetPassingBusesByStop(stop.Id())
 		});
 	}
 
-	const std::unordered_set<BusPointer>* RequestHandler::GetBusesByStop(const std::string_view stop_name) const 
+	ranges::Range<const BusId*> RequestHandler::GetBusesByStop(const transport::Snapshot& snapshot, const std::string_view stop_name) const 
     {
-		StopPointer stop = db_.FindStop(stop_name);
-		return db_.GetPassingBusesByStop(stop);
+		const StopView stop = snapshot.catalogue.FindStop(stop_name);
+		return stop ? snapshot.catalogue.GetPassingBusesByStop(stop.Id()) : ranges::Range<const BusId*>{ nullptr, nullptr };
 	}
 
-	std::tuple<double, int> RequestHandler::ComputeRouteLengths(const std::vector<std::string_view>& route) const 
+	std::tuple<double, int> RequestHandler::ComputeRouteLengths(const std::vector<StopId>& route, bool roundtrip) const 
     {
-		double geographic = 0.0;
-		int actual = 0;
-
-		auto prev_stop = &route[0u];
-		size_t route_sz = route.size();
-		for (size_t i = 1u; i < route_sz; ++i) 
-        {
-			const auto cur_stop = &route[i];
-			const auto res_geogr = db_.GetGeographicDistanceBetweenStops(*prev_stop, *cur_stop);
-			geographic += (res_geogr.has_value()) ? *res_geogr : 0.0;
-
-			const auto res_actual = db_.GetActualDistanceBetweenStops(*prev_stop, *cur_stop);
-			actual += (res_actual.has_value()) ? *res_actual : 0.0;
-
-			prev_stop = cur_stop;
-		}
-
-		return std::tuple<double, int>(geographic, actual);
+		const RouteStops stops = MakeRouteStops(route.data(), route.size(), roundtrip);
+		const auto& db = Draft().catalogue;
+		return std::tuple<double, int>(db.ComputeGeographicLength(stops, length_mode_), db.ComputeActualLength(stops));
 	}
 
-	std::vector<StopPointer> RequestHandler::StopsToStopPointer(const std::vector<std::string_view>& stops) const 
+	void RequestHandler::SetGeographicLengthMode(geo::DistanceMode mode) 
     {
-		std::vector<StopPointer> result;
-		result.reserve(stops.size());
-		for (const auto& stop : stops) 
-        {
-			result.push_back(db_.FindStop(stop));
-		}
-		return result;
+		length_mode_ = mode;
 	}
 
-	std::optional<double> RequestHandler::GetActualDistanceBetweenStops(const std::string_view stop1_name, 
+	std::optional<double> RequestHandler::GetActualDistanceBetweenStops(const transport::Snapshot& snapshot, 
+			const std::string_view stop1_name, 
             const std::string_view stop2_name) const 
     {
-		return db_.GetActualDistanceBetweenStops(stop1_name, stop2_name);
+		return snapshot.catalogue.GetActualDistanceBetweenStops(stop1_name, stop2_name);
 	}
 
-	svg::Document RequestHandler::RenderMap() const 
+	svg::Document RequestHandler::RenderMap(const transport::Snapshot& snapshot) const 
     {
-		std::vector<BusPointer> buses = db_.GetBusesInVector();
-
-		std::vector<std::pair<StopPointer, StopInfo>> stops;
-		for (StopPointer stop : db_.GetStopsInVector())
-        {
-			stops.emplace_back(std::pair<StopPointer, StopInfo>{ stop, * GetStopInfo(*stop.get()->name.get()) });
-		}
-
-		return mr_.MakeDocument(std::move(buses), std::move(stops));
+		return mr_.MakeDocument(snapshot.catalogue.GetBusesSortedByName(), snapshot.catalogue.GetStopsSortedByName());
 	}
 
 	void RequestHandler::SetRenderSettings(renderer::RenderingSettings&& settings) 
@@ -152,56 +155,300 @@ namespace request_handler {
 
 	void RequestHandler::SetRoutingSettings(const double bus_wait_time, const double bus_velocity) 
     {
-		rt_.SetSettings(bus_wait_time, bus_velocity);
+		Draft().router.SetSettings(bus_wait_time, bus_velocity);
+	}
+
+	void RequestHandler::SetRoutingSettings(const transport::Router::Settings& settings) 
+    {
+		Draft().router.SetSettings(settings);
 	}
 
 	void RequestHandler::AddStopToRouter(const std::string_view name) 
     {
-		rt_.AddStop(name);
+		Draft().router.AddStop(name);
 	}
 
-	void RequestHandler::AddWaitEdgeToRouter(const std::string_view stop_name) 
+	void RequestHandler::AddWaitEdgeToRouter(const StopId stop) 
     {
-		rt_.AddWaitEdge(stop_name);
+		Draft().router.AddWaitEdge(stop);
 	}
 
-	void RequestHandler::AddBusEdgeToRouter(const std::string_view stop_from, const std::string_view stop_to, 
+	void RequestHandler::AddBusEdgeToRouter(const StopId stop_from, const StopId stop_to, 
             const std::string_view bus_name, const size_t span_count, const double dist) 
     {
-		rt_.AddBusEdge({stop_from, stop_to, bus_name, span_count, dist});
+		Draft().router.AddBusEdge({stop_from, stop_to, bus_name, span_count, dist});
 	}
 
 	void RequestHandler::FillRouter()
 	{
-		rt_.FillGraph(db_);
+		transport::Snapshot& draft = Draft();
+		draft.router.FillGraph(draft.catalogue);
 		BuildRouter();
 	}
 
 	void RequestHandler::BuildRouter() 
     {
-		rt_.BuildGraph();
-		rt_.BuildRouter();
+		transport::Snapshot& draft = Draft();
+		draft.router.BuildGraph();
+		draft.router.BuildRouter();
+	}
+
+	bool RequestHandler::GetRouteInfo(const transport::Snapshot& snapshot, 
+        const std::string_view from, const std::string_view to, const std::vector<std::string_view>& via, 
+		const transport::RouteOptions& options, transport::RouteInfo& result, transport::RouteSearchStats* stats) const 
+    {
+		const StopView from_stop = snapshot.catalogue.FindStop(from);
+		const StopView to_stop = snapshot.catalogue.FindStop(to);
+		if (!from_stop || !to_stop) { return false; }
+
+		thread_local std::vector<StopId> via_stops;
+		via_stops.clear();
+		for (const std::string_view name : via) 
+        {
+			const StopView stop = snapshot.catalogue.FindStop(name);
+			if (!stop) { return false; }
+			via_stops.push_back(stop.Id());
+		}
+
+		return snapshot.router.GetRouteInfo(from_stop.Id(), to_stop.Id(), via_stops, options, result, stats);
+	}
+
+	bool RequestHandler::GetRouteInfo(const transport::Snapshot& snapshot, const std::vector<transport::SnappedStop>& from, 
+		const std::vector<transport::SnappedStop>& to, const transport::RouteOptions& options, 
+		transport::RouteInfo& result, transport::RouteSearchStats* stats) const 
+    {
+		return snapshot.router.GetRouteInfo(from, to, options, result, stats);
+	}
+
+	transport::RouterMetrics RequestHandler::GetRouterMetrics(const transport::Snapshot& snapshot) const 
+    {
+		return snapshot.router.GetMetrics();
+	}
+
+	memory::Report RequestHandler::GetMemoryReport(const transport::Snapshot& snapshot) const 
+    {
+		memory::Report report;
+		memory::Append(report, "catalogue", snapshot.catalogue.MemoryReport());
+		memory::Append(report, "router", snapshot.router.MemoryReport());
+		memory::Append(report, "renderer", mr_.MemoryReport());
+		return report;
+	}
+
+	void RequestHandler::SetSessionRoutingSettings(const double bus_wait_time, const double bus_velocity) 
+    {
+		Draft().router.SetSessionMetric(bus_wait_time, bus_velocity);
+	}
+
+	std::vector<transport::SnappedStop> RequestHandler::SnapToStops(const transport::Snapshot& snapshot, geo::Coordinates point) const 
+    {
+		std::vector<transport::SnappedStop> result;
+		for (const auto& nearby : snapshot.catalogue.FindNearestStops(point, snapshot.router.GetRouterSettings().snap_stops_count)) 
+        {
+			result.push_back({ nearby.stop, snapshot.catalogue.GetStop(nearby.stop).Name(), nearby.distance });
+		}
+		return result;
+	}
+
+	std::vector<NearbyStop> RequestHandler::FindNearbyStops(const transport::Snapshot& snapshot, geo::Coordinates point, 
+		std::optional<size_t> count, std::optional<double> radius) const 
+    {
+		if (count && radius) 
+        {
+			return snapshot.catalogue.FindNearestStopsWithinRadius(point, *count, *radius);
+		}
+		if (count) 
+        {
+			return snapshot.catalogue.FindNearestStops(point, *count);
+		}
+		return snapshot.catalogue.FindStopsWithinRadius(point, radius.value_or(0.0));
+	}
+
+	std::string_view RequestHandler::GetStopName(const transport::Snapshot& snapshot, StopId stop) const 
+    {
+		return snapshot.catalogue.GetStop(stop).Name();
+	}
+
+	std::vector<StopId> RequestHandler::SearchStops(const transport::Snapshot& snapshot, 
+		const std::string_view query, size_t max_edits, bool as_prefix) const 
+    {
+		return snapshot.catalogue.SearchStops(query, max_edits, as_prefix);
+	}
+
+	std::vector<BusId> RequestHandler::SearchBuses(const transport::Snapshot& snapshot, 
+		const std::string_view query, size_t max_edits, bool as_prefix) const 
+    {
+		return snapshot.catalogue.SearchBuses(query, max_edits, as_prefix);
+	}
+
+	NetworkAnalytics RequestHandler::GetNetworkAnalytics(const transport::Snapshot& snapshot, const AnalyticsOptions& options) const 
+    {
+		NetworkAnalytics result = snapshot.catalogue.ComputeAnalytics(options);
+		if (options.travel_time) 
+        {
+			result.travel_time = snapshot.router.ComputeTravelTimes();
+		}
+		return result;
 	}
 
-	std::optional<transport::RouteInfo> RequestHandler::GetRouteInfo(
-        const std::string_view from, const std::string_view to) const 
+	std::optional<std::vector<BusId>> RequestHandler::FindDirectBuses(const transport::Snapshot& snapshot, 
+		const std::string_view from, const std::string_view to, bool ordered) const 
     {
-		return rt_.GetRouteInfo(from, to);
+		const StopView from_stop = snapshot.catalogue.FindStop(from);
+		const StopView to_stop = snapshot.catalogue.FindStop(to);
+		if (!from_stop || !to_stop) { return {}; }
+
+		return snapshot.catalogue.FindDirectBuses(from_stop.Id(), to_stop.Id(), ordered);
 	}
 
 	void RequestHandler::SetSerializationSettings(const std::string& filename) 
 	{
-		sz_.SetFileName(filename);
+		serialization_file_ = filename;
 	}
 
 	void RequestHandler::Serialize()
 	{
-		sz_.Serialize();
+		transport::Snapshot& draft = Draft();
+		serialize::Serializer sz(draft.catalogue, mr_);
+		sz.SetFileName(serialization_file_);
+		sz.SetTransportRouter(draft.router);
+		sz.Serialize();
 	}
 
 	void RequestHandler::Deserialize()
 	{
-		sz_.Deserialize();
+		transport::Snapshot& draft = Draft();
+		serialize::Serializer sz(draft.catalogue, mr_);
+		sz.SetFileName(serialization_file_);
+		sz.SetTransportRouter(draft.router);
+		sz.Deserialize();
+		length_mode_ = draft.catalogue.GetGeographicLengthMode();
+	}
+
+	void RequestHandler::BeginUpdate() 
+    {
+		const auto current = snapshots_.Acquire();
+		if (!current) 
+        {
+			draft_ = std::make_shared<transport::Snapshot>();
+			return;
+		}
+		draft_ = std::make_shared<transport::Snapshot>(current->catalogue);
+		draft_->router.SetSettings(current->router.GetRouterSettings());
+	}
+
+	void RequestHandler::BeginUpdate(const BaseDelta& delta) 
+    {
+		const auto current = snapshots_.Acquire();
+		if (!current) 
+        {
+			throw std::logic_error("No published version to update");
+		}
+		const transport::TransportCatalogue& base = current->catalogue;
+
+		std::unordered_map<std::string_view, const Stop*> replaced_stops;
+		for (const Stop& stop : delta.stops) 
+        {
+			replaced_stops[stop.name] = &stop;
+		}
+		const std::unordered_set<std::string_view> removed_stops(delta.removed_stops.begin(), delta.removed_stops.end());
+		const std::unordered_set<std::string_view> removed_buses(delta.removed_buses.begin(), delta.removed_buses.end());
+
+		draft_ = std::make_shared<transport::Snapshot>();
+		draft_->router.SetSettings(current->router.GetRouterSettings());
+		transport::TransportCatalogue& db = draft_->catalogue;
+		db.SetGeographicLengthMode(length_mode_);
+		// Buses computed in another mode than the one asked for now all get new stats
+		const bool mode_changed = base.GetGeographicLengthMode() != length_mode_;
+
+		// Kept stops stay in order with the removed ones squeezed out, new stops go last
+		std::vector<StopId> new_ids(base.GetStopCount(), NO_STOP);
+		std::vector<bool> replaced(base.GetStopCount(), false);
+		for (StopId id = 0u; id < base.GetStopCount(); ++id) 
+        {
+			const StopView stop = base.GetStop(id);
+			if (removed_stops.count(stop.Name())) { continue; }
+
+			const auto it = replaced_stops.find(stop.Name());
+			replaced[id] = (it != replaced_stops.end());
+			const geo::Coordinates coords = replaced[id] ? it->second->coords : stop.Coords();
+			new_ids[id] = db.AddStop(Stop(std::string(stop.Name()), coords.lat, coords.lng));
+		}
+		for (const Stop& stop : delta.stops) 
+        {
+			db.AddStop(Stop(stop));
+		}
+
+		base.GetDistances().ForEach([&](StopId from, StopId to, int distance) 
+        {
+			if (!replaced[from] && new_ids[from] != NO_STOP && new_ids[to] != NO_STOP) 
+            {
+				db.SetDistanceBetweenStops(base.GetStop(from).Name(), base.GetStop(to).Name(), distance);
+			}
+		});
+		for (const auto& [from, to, distance] : delta.road_distances) 
+        {
+			db.SetDistanceBetweenStops(from, to, distance);
+		}
+
+		// Every changed distance starts at a replaced stop, so only buses passing one need new stats
+		// unless the mode changed
+		for (BusId id = 0u; id < base.GetBusCount(); ++id) 
+        {
+			const BusView bus = base.GetBus(id);
+			if (removed_buses.count(bus.Name())) { continue; }
+
+			std::vector<StopId> route;
+			route.reserve(bus.StoredStops().size());
+			bool affected = mode_changed;
+			for (const StopId stop : bus.StoredStops()) 
+            {
+				if (new_ids[stop] == NO_STOP) 
+                {
+					throw std::invalid_argument("Stop \""s + std::string(base.GetStop(stop).Name()) 
+						+ "\" is removed but still on bus \""s + std::string(bus.Name()) + "\""s);
+				}
+				affected = affected || replaced[stop];
+				route.push_back(new_ids[stop]);
+			}
+
+			double geographic = bus.RouteGeographicLength();
+			int actual = bus.RouteActualLength();
+			if (affected) 
+            {
+				std::tie(geographic, actual) = ComputeRouteLengths(route, bus.IsRoundtrip());
+			}
+			const StopId last_stop = bus.LastStop() ? new_ids[bus.LastStop().Id()] : NO_STOP;
+			db.AddBus(Bus(std::string(bus.Name()), std::move(route), bus.UniqueStops(), 
+				actual, geographic, bus.IsRoundtrip(), last_stop));
+		}
+	}
+
+	void RequestHandler::PublishDraft() 
+    {
+		snapshots_.Publish(std::move(draft_));
+	}
+
+	std::shared_ptr<const transport::Snapshot> RequestHandler::AcquireSnapshot() const 
+    {
+		return snapshots_.Acquire();
+	}
+
+	transport::Snapshot& RequestHandler::Draft() 
+    {
+		if (!draft_) 
+        {
+			throw std::logic_error("No draft to write to, BeginUpdate has to follow PublishDraft");
+		}
+		return *draft_;
+	}
+
+	const transport::Snapshot& RequestHandler::Draft() const 
+    {
+		if (!draft_) 
+        {
+			throw std::logic_error("No draft to write to, BeginUpdate has to follow PublishDraft");
+		}
+		return *draft_;
 	}
 
 	std::tuple<std::string, size_t> RequestHandler::QueryGetName(const std::string_view str) const 
@@ -269,8 +516,7 @@ namespace request_handler {
 
 		for (size_t i = 1u; i < words.size(); ++i) 
         {
-			StopPointer stop = db_.FindStop(words[i]);
-			result.push_back(*stop->name.get());
+			result.push_back(Draft().catalogue.FindStop(words[i]).Name());
 			stops_unique_names.insert(words[i]);
 		}
 
@@ -279,8 +525,7 @@ namespace request_handler {
 			result.reserve(words.size() * 2u);
 			for (size_t i = words.size() - 2u; i >= 1u; --i) 
             {
-				StopPointer stop = db_.FindStop(words[i]);
-				result.push_back(*stop->name.get());
+				result.push_back(Draft().catalogue.FindStop(words[i]).Name());
 			}
 		}
 
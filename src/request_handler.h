@@ -1,5 +1,6 @@
 #pragma once
 
+#include "catalogue_snapshot.h"
 #include "transport_catalogue.h"
 #include "map_renderer.h"
 #include "transport_router.h"
@@ -14,6 +15,10 @@
 
 namespace request_handler 
 {
+	// Writers fill a draft version of the catalogue and router and publish it; readers acquire
+	// the published version and pass it to the queries, which only read it. A version stays
+	// valid for as long as someone holds it, see transport::SnapshotHolder.
+	// Writer calls must come from one thread at a time
 	class RequestHandler 
 	{
 	private:
@@ -25,48 +30,107 @@ namespace request_handler
 		};
 
 	public:
-		RequestHandler(transport::TransportCatalogue& db, renderer::MapRenderer& mr);
+		explicit RequestHandler(renderer::MapRenderer& mr);
 
+		// Writer side: acts on the draft
 		void AddBus(domain::Bus&& bus);
+		// Computes the stats of the buses, in parallel, then adds them in order
+		void AddBuses(std::vector<domain::Bus>&& buses);
 		void AddStop(domain::Stop&& stop);
+		void BuildCatalogueIndexes();
 
 		void SetDistanceBetweenStops(const std::string_view raw_query);
 		void SetDistanceBetweenStops(const std::string_view first, const std::string_view second, double distance);
 
-		domain::BusPointer FindBus(const std::string_view name) const;
-		domain::StopPointer FindStop(const std::string_view name) const;
+		domain::StopView FindStop(const std::string_view name) const;
+		// Geographic and actual lengths of a route of the draft's stops, stored as in domain::Bus
+		std::tuple<double, int> ComputeRouteLengths(const std::vector<domain::StopId>& route, bool roundtrip) const;
+		// APPROXIMATE is only fit for curvature, see geo::DistanceMode. Deserialize restores the
+		// mode the base was built in; an update in another mode recomputes every bus
+		void SetGeographicLengthMode(geo::DistanceMode mode);
 
-		const std::vector<domain::BusPointer> GetBusesInVector() const;
-		const std::vector<domain::StopPointer> GetStopsInVector() const;
-
-		std::optional<domain::BusInfo> GetBusInfo(const std::string_view bus_name) const;
-		std::optional<domain::StopInfo> GetStopInfo(const std::string_view stop_name) const;
-
-		const std::unordered_set<domain::BusPointer>* GetBusesByStop(const std::string_view stop_name) const;
-		std::tuple<double, int> ComputeRouteLengths(const std::vector<std::string_view>& routh) const;
-		std::vector<domain::StopPointer> StopsToStopPointer(const std::vector<std::string_view>& stops) const;
-
-		std::optional<double> GetActualDistanceBetweenStops(const std::string_view stop1_name, const std::string_view stop2_name) const;
-
-		svg::Document RenderMap() const;
 		void SetRenderSettings(renderer::RenderingSettings&& settings);
 
 		void SetRoutingSettings(const double bus_wait_time, const double bus_velocity);
+		void SetRoutingSettings(const transport::Router::Settings& settings);
 		void AddStopToRouter(const std::string_view name);
-		void AddWaitEdgeToRouter(const std::string_view stop_name);
-		void AddBusEdgeToRouter(const std::string_view stop_from, const std::string_view stop_to, const std::string_view bus_name, const size_t span_count, const double dist);
+		void AddWaitEdgeToRouter(const domain::StopId stop);
+		void AddBusEdgeToRouter(const domain::StopId stop_from, const domain::StopId stop_to, const std::string_view bus_name, const size_t span_count, const double dist);
 		void FillRouter();
 		void BuildRouter();
-		std::optional<transport::RouteInfo> GetRouteInfo(const std::string_view from, const std::string_view to) const;
+		void SetSessionRoutingSettings(const double bus_wait_time, const double bus_velocity);
 
 		void SetSerializationSettings(const std::string& filename);
 		void Serialize();
+		// Loads the base into the draft; the router is built by FillRouter where queries need it
 		void Deserialize();
+
+		// Starts a draft from a copy of the published version's data and routing settings;
+		// indexes and router have to be built again before publishing
+		void BeginUpdate();
+		// Same, with the stops, road distances and removals of the delta applied. Kept buses keep
+		// their stored stats unless they pass a replaced stop; the delta's buses are added afterwards.
+		// Throws std::invalid_argument if a kept bus passes a removed stop
+		void BeginUpdate(const domain::BaseDelta& delta);
+		// Makes the draft the version readers acquire; there is no draft again until BeginUpdate
+		void PublishDraft();
+
+		// Reader side: any number of threads, each query reads only the version passed in.
+		// Views, ranges and names returned point into that version
+		std::shared_ptr<const transport::Snapshot> AcquireSnapshot() const;
+
+		domain::BusView FindBus(const transport::Snapshot& snapshot, const std::string_view name) const;
+		domain::StopView FindStop(const transport::Snapshot& snapshot, const std::string_view name) const;
+		std::string_view GetBusName(const transport::Snapshot& snapshot, domain::BusId bus) const;
+		std::string_view GetStopName(const transport::Snapshot& snapshot, domain::StopId stop) const;
+
+		// Views made on the fly in id order, see TransportCatalogue::GetStops
+		domain::StopViews GetStops(const transport::Snapshot& snapshot) const;
+		domain::BusViews GetBuses(const transport::Snapshot& snapshot) const;
+
+		std::optional<domain::BusInfo> GetBusInfo(const transport::Snapshot& snapshot, const std::string_view bus_name) const;
+		std::optional<domain::StopInfo> GetStopInfo(const transport::Snapshot& snapshot, const std::string_view stop_name) const;
+
+		ranges::Range<const domain::BusId*> GetBusesByStop(const transport::Snapshot& snapshot, const std::string_view stop_name) const;
+		std::optional<double> GetActualDistanceBetweenStops(const transport::Snapshot& snapshot, 
+			const std::string_view stop1_name, const std::string_view stop2_name) const;
+
+		svg::Document RenderMap(const transport::Snapshot& snapshot) const;
+
+		// Unknown stops are answered as "no route"
+		bool GetRouteInfo(const transport::Snapshot& snapshot, const std::string_view from, const std::string_view to, 
+			const std::vector<std::string_view>& via, const transport::RouteOptions& options, 
+			transport::RouteInfo& result, transport::RouteSearchStats* stats = nullptr) const;
+		bool GetRouteInfo(const transport::Snapshot& snapshot, const std::vector<transport::SnappedStop>& from, 
+			const std::vector<transport::SnappedStop>& to, const transport::RouteOptions& options, 
+			transport::RouteInfo& result, transport::RouteSearchStats* stats = nullptr) const;
+		// Counted per version: a newly published one starts from zero
+		transport::RouterMetrics GetRouterMetrics(const transport::Snapshot& snapshot) const;
+		// Heap bytes and element counts of every container behind the version and the renderer
+		memory::Report GetMemoryReport(const transport::Snapshot& snapshot) const;
+		std::vector<transport::SnappedStop> SnapToStops(const transport::Snapshot& snapshot, geo::Coordinates point) const;
+		// Nearest stops first; without a count every stop within the radius is returned
+		std::vector<domain::NearbyStop> FindNearbyStops(const transport::Snapshot& snapshot, geo::Coordinates point, 
+			std::optional<size_t> count, std::optional<double> radius) const;
+		// Name search for autocompletion, see TransportCatalogue::SearchStops
+		std::vector<domain::StopId> SearchStops(const transport::Snapshot& snapshot, 
+			const std::string_view query, size_t max_edits, bool as_prefix) const;
+		std::vector<domain::BusId> SearchBuses(const transport::Snapshot& snapshot, 
+			const std::string_view query, size_t max_edits, bool as_prefix) const;
+		// The catalogue's aggregates plus the router's travel times, see domain::NetworkAnalytics
+		domain::NetworkAnalytics GetNetworkAnalytics(const transport::Snapshot& snapshot, const domain::AnalyticsOptions& options) const;
+		// Empty if either stop is unknown, see TransportCatalogue::FindDirectBuses
+		std::optional<std::vector<domain::BusId>> FindDirectBuses(const transport::Snapshot& snapshot, 
+			const std::string_view from, const std::string_view to, bool ordered) const;
 	private:
-		transport::TransportCatalogue& db_;
 		renderer::MapRenderer& mr_;
-		transport::Router rt_;
-		serialize::Serializer sz_;
+		std::shared_ptr<transport::Snapshot> draft_;
+		transport::SnapshotHolder snapshots_;
+		std::string serialization_file_;
+		geo::DistanceMode length_mode_ = geo::DistanceMode::EXACT;
+
+		transport::Snapshot& Draft();
+		const transport::Snapshot& Draft() const;
 
 		std::tuple<std::string, std::size_t> QueryGetName(const std::string_view str) const;
 		std::tuple<std::string, std::string> SplitIntoLengthStop(std::string&& str) const;
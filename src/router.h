@@ -28,6 +28,21 @@ public:
     };
 
     std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+    // Weight of the best route as stored in the table, nullopt if there is none
+    std::optional<Weight> GetRouteWeight(VertexId from, VertexId to) const {
+        const auto& route_internal_data = routes_internal_data_[from][to];
+        return route_internal_data ? std::optional<Weight>(route_internal_data->weight) : std::nullopt;
+    }
+
+    using Endpoint = RouteEndpoint<Weight>;
+    using Path = RoutePath<Weight>;
+
+    // Best route over all source/target pairs, its weight includes both endpoint offsets.
+    // Writes into `path` and allocates only if its edges storage has to grow
+    bool BuildRoute(const std::vector<Endpoint>& sources, const std::vector<Endpoint>& targets, Path& path) const;
+
+    // One row of the routes table per vertex, each with an entry per vertex
+    memory::Report MemoryReport() const;
 
 private:
     struct RouteInternalData {
@@ -75,6 +90,9 @@ private:
         }
     }
 
+    void WriteRouteEdges(VertexId from, const RouteInternalData& route_internal_data,
+                         std::vector<EdgeId>& edges) const;
+
     static constexpr Weight ZERO_WEIGHT{};
     const Graph& graph_;
     RoutesInternalData routes_internal_data_;
@@ -94,6 +112,11 @@ TransportRouter<Weight>::TransportRouter(const Graph& graph)
     }
 }
 
+template <typename Weight>
+memory::Report TransportRouter<Weight>::MemoryReport() const {
+    return {memory::Of("routes_internal_data", routes_internal_data_)};
+}
+
 template <typename Weight>
 std::optional<typename TransportRouter<Weight>::RouteInfo> TransportRouter<Weight>::BuildRoute(VertexId from,
                                                                              VertexId to) const {
@@ -101,17 +124,61 @@ std::optional<typename TransportRouter<Weight>::RouteInfo> TransportRouter<Weigh
     if (!route_internal_data) {
         return std::nullopt;
     }
-    const Weight weight = route_internal_data->weight;
-    std::vector<EdgeId> edges;
-    for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
+    RouteInfo route{route_internal_data->weight, {}};
+    WriteRouteEdges(from, *route_internal_data, route.edges);
+    return route;
+}
+
+template <typename Weight>
+bool TransportRouter<Weight>::BuildRoute(const std::vector<Endpoint>& sources, const std::vector<Endpoint>& targets,
+                                         Path& path) const {
+    // Every source row of the routes table is a complete shortest-path tree,
+    // so the best pair is picked by table lookups and only its path is rebuilt
+    const RouteInternalData* best = nullptr;
+    for (size_t source_index = 0; source_index < sources.size(); ++source_index) {
+        const Endpoint& source = sources[source_index];
+        const auto& row = routes_internal_data_.at(source.vertex);
+        for (size_t target_index = 0; target_index < targets.size(); ++target_index) {
+            const Endpoint& target = targets[target_index];
+            const auto& route_internal_data = row.at(target.vertex);
+            if (!route_internal_data) {
+                continue;
+            }
+            const Weight weight = source.offset + route_internal_data->weight + target.offset;
+            if (!best || weight < path.weight) {
+                best = &*route_internal_data;
+                path.weight = weight;
+                path.source_index = source_index;
+                path.target_index = target_index;
+            }
+        }
+    }
+    if (!best) {
+        return false;
+    }
+    WriteRouteEdges(sources[path.source_index].vertex, *best, path.edges);
+    return true;
+}
+
+template <typename Weight>
+void TransportRouter<Weight>::WriteRouteEdges(VertexId from, const RouteInternalData& route_internal_data,
+                                              std::vector<EdgeId>& edges) const {
+    // The chain is walked twice, first to size the output and then to fill it
+    // back to front, so the edges come out in travel order without a reverse
+    size_t length = 0;
+    for (std::optional<EdgeId> edge_id = route_internal_data.prev_edge;
+         edge_id;
+         edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge)
+    {
+        ++length;
+    }
+    edges.resize(length);
+    for (std::optional<EdgeId> edge_id = route_internal_data.prev_edge;
          edge_id;
          edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge)
     {
-        edges.push_back(*edge_id);
+        edges[--length] = *edge_id;
     }
-    std::reverse(edges.begin(), edges.end());
-
-    return RouteInfo{weight, std::move(edges)};
 }
 
 }  // namespace graph
\ No newline at end of file
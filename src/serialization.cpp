@@ -1,35 +1,42 @@
 #include "serialization.h"
 
-#include <set>
-
 using namespace std;
 using namespace transport;
 
-std::tuple<double, int> ComputeRouteLengths(const TransportCatalogue& db, const std::vector<std::string_view>& route) 
+// None for bases written before the hashes were stored
+optional<domain::PerfectHash::Layout> ReadNamesHash(const transport_catalogue_serialize::NamesHash& hash_pb, bool present)
 {
-    double geographic = 0.0;
-    int actual = 0;
-
-    auto prev_stop = &route[0u];
-    size_t route_sz = route.size();
-    for (size_t i = 1u; i < route_sz; ++i) 
+    if (!present)
     {
-        const auto cur_stop = &route[i];
-        const auto res_geogr = db.GetGeographicDistanceBetweenStops(*prev_stop, *cur_stop);
-        geographic += (res_geogr.has_value()) ? *res_geogr : 0.0;
-
-        const auto res_actual = db.GetActualDistanceBetweenStops(*prev_stop, *cur_stop);
-        actual += (res_actual.has_value()) ? *res_actual : 0;
-
-        prev_stop = cur_stop;
+        return nullopt;
     }
-
-    return std::tuple<double, int>(geographic, actual);
+    domain::PerfectHash::Layout layout;
+    layout.seeds.assign(hash_pb.seeds().begin(), hash_pb.seeds().end());
+    layout.keys.assign(hash_pb.keys().begin(), hash_pb.keys().end());
+    return layout;
 }
 
 namespace serialize
 {
 
+namespace
+{
+// Blocks large enough that a base of millions of route stops takes a few hundred of them
+google::protobuf::ArenaOptions MakeArenaOptions()
+{
+    google::protobuf::ArenaOptions options;
+    options.start_block_size = 64u << 10;
+    options.max_block_size = 1u << 20;
+    return options;
+}
+}
+
+Serializer::Serializer(transport::TransportCatalogue& transport_catalogue, renderer::MapRenderer& map_renderer)
+    : arena_(MakeArenaOptions())
+    , transport_catalogue_serialize_(*google::protobuf::Arena::CreateMessage<transport_catalogue_serialize::TransportCatalogue>(&arena_))
+    , transport_catalogue_(transport_catalogue)
+    , map_renderer_(map_renderer) {}
+
 
 void Serializer::Serialize()
 {
@@ -40,6 +47,9 @@ void Serializer::Serialize()
     SerializeDistance();
     SerializeRenderSettings();
     SerializeRoutingSettings();
+    SerializeStopsIndex();
+    SerializeNameIndexes();
+    SerializeNamesHashes();
 
     transport_catalogue_serialize_.SerializeToOstream(&ofs);
 }
@@ -57,6 +67,7 @@ void Serializer::Deserialize()
     DeserializeStop();
     DeserializeDistance();
     DeserializeBus();
+    DeserializeIndexes();
 
     // Router
     DeserializeRoutingSettings();
@@ -76,59 +87,97 @@ void Serializer::SetTransportRouter(transport::Router& transport_router)
 
 void Serializer::SerializeStop()
 {
-    for (const auto& stop: transport_catalogue_.GetStopsInVector())
+    // Parts are built in place on the arena rather than copied in from temporaries
+    for (const domain::StopView stop: transport_catalogue_.GetStops())
     {
-        transport_catalogue_serialize::Stop stop_pb;
-        stop_pb.set_name(*(stop->name));
-
-        transport_catalogue_serialize::Coordinates coordinates_pb;
-        coordinates_pb.set_lat(stop->coords.lat);
-        coordinates_pb.set_lng(stop->coords.lng);
-
-        *stop_pb.mutable_coordinates() = coordinates_pb;
-        *transport_catalogue_serialize_.add_stops() = stop_pb;
+        transport_catalogue_serialize::Stop* stop_pb = transport_catalogue_serialize_.add_stops();
+        stop_pb->set_name(stop.Name().data(), stop.Name().size());
+        stop_pb->mutable_coordinates()->set_lat(stop.Coords().lat);
+        stop_pb->mutable_coordinates()->set_lng(stop.Coords().lng);
     }
 }
 
 void Serializer::SerializeBus()
 {
-    for (const auto& bus: transport_catalogue_.GetBusesInVector())
+    transport_catalogue_serialize_.set_approximate_geographic_length(
+        transport_catalogue_.GetGeographicLengthMode() == geo::DistanceMode::APPROXIMATE);
+    for (const domain::BusView bus: transport_catalogue_.GetBuses())
     {
-        transport_catalogue_serialize::Bus bus_pb;
-        bus_pb.set_name(*(bus->name));
-        bus_pb.set_roundtrip(bus->roundtrip);
+        transport_catalogue_serialize::Bus* bus_pb = transport_catalogue_serialize_.add_buses();
+        bus_pb->set_name(bus.Name().data(), bus.Name().size());
+        bus_pb->set_roundtrip(bus.IsRoundtrip());
         
-        for (const auto stop: bus->route)
+        // Stops are found by name on reading, their coordinates are stored once in stops
+        bus_pb->set_way_out_only(true);
+        bus_pb->mutable_stops()->Reserve(static_cast<int>(bus.StoredStops().size()));
+        for (const domain::StopId stop_id: bus.StoredStops())
         {
-            transport_catalogue_serialize::Stop stop_pb;
-            stop_pb.set_name(*(stop->name));
-
-            transport_catalogue_serialize::Coordinates coordinates_pb;
-            coordinates_pb.set_lat(stop->coords.lat);
-            coordinates_pb.set_lng(stop->coords.lng);
-
-            *stop_pb.mutable_coordinates() = coordinates_pb;
-            *bus_pb.add_stops() = stop_pb;
+            const std::string_view name = transport_catalogue_.GetStop(stop_id).Name();
+            bus_pb->add_stops()->set_name(name.data(), name.size());
         }
 
-        string last_stop = (bus->last_stop != nullptr) ? (*(bus->last_stop->name)) : ("");
-        bus_pb.set_laststop(last_stop);
+        if (bus.LastStop())
+        {
+            bus_pb->set_laststop(bus.LastStop().Name().data(), bus.LastStop().Name().size());
+        }
 
-        *transport_catalogue_serialize_.add_buses() = bus_pb;
+        bus_pb->set_unique_stops(bus.UniqueStops());
+        bus_pb->set_route_actual_length(bus.RouteActualLength());
+        bus_pb->set_route_geographic_length(bus.RouteGeographicLength());
     }
 }
 
 void Serializer::SerializeDistance()
 {
-    for (const auto stop_pair: transport_catalogue_.GetStopPairsToDistance())
+    transport_catalogue_.GetDistances().ForEach([this](domain::StopId from, domain::StopId to, int distance)
     {
-        transport_catalogue_serialize::Distance distance_pb;
-        distance_pb.set_from(*(stop_pair.first.first->name));
-        distance_pb.set_to(*(stop_pair.first.second->name));
-        distance_pb.set_distance(stop_pair.second);
+        const string_view from_name = transport_catalogue_.GetStop(from).Name();
+        const string_view to_name = transport_catalogue_.GetStop(to).Name();
+        transport_catalogue_serialize::Distance* distance_pb = transport_catalogue_serialize_.add_distances();
+        distance_pb->set_from(from_name.data(), from_name.size());
+        distance_pb->set_to(to_name.data(), to_name.size());
+        distance_pb->set_distance(distance);
+    });
+}
 
-        *transport_catalogue_serialize_.add_distances() = distance_pb;
+void Serializer::SerializeStopsIndex()
+{
+    const geo::GridIndex& index = transport_catalogue_.GetStopsIndex();
+    if (index.Empty())
+    {
+        return;
     }
+
+    const geo::GridIndex::Layout layout = index.GetLayout();
+    transport_catalogue_serialize::StopsIndex index_pb;
+    index_pb.set_ref_cos_lat(layout.ref_cos_lat);
+    index_pb.set_min_x(layout.min_x);
+    index_pb.set_min_y(layout.min_y);
+    index_pb.set_cell_size(layout.cell_size);
+    index_pb.set_cols(layout.cols);
+    index_pb.set_rows(layout.rows);
+    *index_pb.mutable_cell_start() = { layout.cell_start.begin(), layout.cell_start.end() };
+    *index_pb.mutable_cell_points() = { layout.cell_points.begin(), layout.cell_points.end() };
+
+    *transport_catalogue_serialize_.mutable_stops_index() = move(index_pb);
+}
+
+void Serializer::SerializeNameIndexes()
+{
+    const auto& stops_by_name = transport_catalogue_.GetStopsByName();
+    const auto& buses_by_name = transport_catalogue_.GetBusesByName();
+    *transport_catalogue_serialize_.mutable_stops_by_name() = { stops_by_name.begin(), stops_by_name.end() };
+    *transport_catalogue_serialize_.mutable_buses_by_name() = { buses_by_name.begin(), buses_by_name.end() };
+}
+
+void Serializer::SerializeNamesHashes()
+{
+    const auto write = [](const domain::PerfectHash::Layout& layout, transport_catalogue_serialize::NamesHash* hash_pb) {
+        *hash_pb->mutable_seeds() = { layout.seeds.begin(), layout.seeds.end() };
+        *hash_pb->mutable_keys() = { layout.keys.begin(), layout.keys.end() };
+    };
+    write(transport_catalogue_.GetStopNamesHash(), transport_catalogue_serialize_.mutable_stop_names_hash());
+    write(transport_catalogue_.GetBusNamesHash(), transport_catalogue_serialize_.mutable_bus_names_hash());
 }
 
 void Serializer::SerializeRenderSettings()
@@ -172,6 +221,10 @@ void Serializer::SerializeRoutingSettings()
 
     routing_settings_pb.set_bus_velocity(routing_settings.velocity);
     routing_settings_pb.set_bus_wait_time(routing_settings.wait_time);
+    routing_settings_pb.set_pedestrian_velocity(routing_settings.pedestrian_velocity);
+    routing_settings_pb.set_snap_stops_count(routing_settings.snap_stops_count);
+    routing_settings_pb.set_walk_transfer_radius(routing_settings.walk_transfer_radius);
+    routing_settings_pb.set_walk_transfer_max_neighbours(routing_settings.walk_transfer_max_neighbours);
 
     *transport_catalogue_serialize_.mutable_routing_settings() = routing_settings_pb;
 }
@@ -210,18 +263,21 @@ transport_catalogue_serialize::Color Serializer::SerializeColor(const svg::Color
 
 void Serializer::DeserializeStop()
 {
+    vector<domain::Stop> stops;
+    stops.reserve(transport_catalogue_serialize_.stops().size());
     for (int i = 0; i < transport_catalogue_serialize_.stops().size(); ++i)
     {
-        auto stop_pb = transport_catalogue_serialize_.stops(i);
+        const auto& stop_pb = transport_catalogue_serialize_.stops(i);
         
-        domain::Stop stop(
+        stops.emplace_back(
             move(string(stop_pb.name())),
             stop_pb.coordinates().lat(),
             stop_pb.coordinates().lng()
         );
-
-        transport_catalogue_.AddStop(move(stop));        
     }
+
+    transport_catalogue_.AddStoredStops(move(stops), ReadNamesHash(
+        transport_catalogue_serialize_.stop_names_hash(), transport_catalogue_serialize_.has_stop_names_hash()));
 }
 
 void Serializer::DeserializeBus()
@@ -235,41 +291,55 @@ void Serializer::DeserializeBus()
     // - last stop
     // - !Stops are initialized in transport_catalogue
 
+    vector<domain::Bus> buses;
+    buses.reserve(transport_catalogue_serialize_.buses().size());
+    bool stats_stored = true;
+    // Bases written before the mode was stored were all computed exactly
+    transport_catalogue_.SetGeographicLengthMode(transport_catalogue_serialize_.approximate_geographic_length()
+        ? geo::DistanceMode::APPROXIMATE : geo::DistanceMode::EXACT);
     for (int i = 0; i < transport_catalogue_serialize_.buses().size(); ++i)
     {
-        auto bus_pb = transport_catalogue_serialize_.buses(i);
+        const auto& bus_pb = transport_catalogue_serialize_.buses(i);
         
-        vector<string_view> route_names;
-        vector<domain::StopPointer> route;
-        set<string_view> unique_stops;
-        for (const auto& stop_pb: bus_pb.stops())
+        // Bases written with the whole route of a bus that is not a roundtrip keep its way out only
+        int stops_count = bus_pb.stops().size();
+        if (!bus_pb.way_out_only() && !bus_pb.roundtrip() && stops_count > 1)
         {
-            route_names.push_back(stop_pb.name());
-            route.push_back(transport_catalogue_.FindStop(stop_pb.name()));
-            unique_stops.emplace(stop_pb.name());
+            stops_count = (stops_count + 1) / 2;
         }
-        
-        auto [geographic, actual] = ComputeRouteLengths(transport_catalogue_, route_names);
+        vector<domain::StopId> route;
+        route.reserve(stops_count);
+        for (int j = 0; j < stops_count; ++j)
+        {
+            route.push_back(transport_catalogue_.FindStop(bus_pb.stops(j).name()).Id());
+        }
+        stats_stored = stats_stored && bus_pb.unique_stops() != 0;
 
-        domain::Bus bus(
+        buses.emplace_back(
             move(string(bus_pb.name())),
             move(route),
-            unique_stops.size(),
-            actual,
-            geographic,
+            bus_pb.unique_stops(),
+            static_cast<int>(bus_pb.route_actual_length()),
+            bus_pb.route_geographic_length(),
             bus_pb.roundtrip(),
-            transport_catalogue_.FindStop(bus_pb.laststop())
+            bus_pb.laststop().empty() ? domain::NO_STOP : transport_catalogue_.FindStop(bus_pb.laststop()).Id()
         );
+    }
 
-        transport_catalogue_.AddBus(move(bus));
+    // Bases written before the stats were stored get them recomputed
+    if (!stats_stored)
+    {
+        transport_catalogue_.ComputeBusStats(buses, transport_catalogue_.GetGeographicLengthMode());
     }
+    transport_catalogue_.AddStoredBuses(move(buses), ReadNamesHash(
+        transport_catalogue_serialize_.bus_names_hash(), transport_catalogue_serialize_.has_bus_names_hash()));
 }
 
 void Serializer::DeserializeDistance()
 {
     for (int i = 0; i < transport_catalogue_serialize_.distances().size(); ++i)
     {
-        transport_catalogue_serialize::Distance distance_pb = transport_catalogue_serialize_.distances(i);
+        const auto& distance_pb = transport_catalogue_serialize_.distances(i);
         transport_catalogue_.SetDistanceBetweenStops(distance_pb.from(), distance_pb.to(), distance_pb.distance());
     }
 }
@@ -277,7 +347,7 @@ void Serializer::DeserializeDistance()
 void Serializer::DeserializeRenderSettings()
 {
     renderer::RenderingSettings render_settings;
-    auto render_settings_pb = transport_catalogue_serialize_.render_settings();
+    const auto& render_settings_pb = transport_catalogue_serialize_.render_settings();
 
     render_settings.width = render_settings_pb.width();
     render_settings.height = render_settings_pb.height();
@@ -302,12 +372,51 @@ void Serializer::DeserializeRenderSettings()
 
 void Serializer::DeserializeRoutingSettings()
 {
-    auto routing_settings_pb = transport_catalogue_serialize_.routing_settings();
-    transport_router_.value()->SetSettings(routing_settings_pb.bus_wait_time(), routing_settings_pb.bus_velocity());
+    const auto& routing_settings_pb = transport_catalogue_serialize_.routing_settings();
+    transport::Router::Settings routing_settings;
+    routing_settings.wait_time = routing_settings_pb.bus_wait_time();
+    routing_settings.velocity = routing_settings_pb.bus_velocity();
+    // Bases written before these fields existed keep the defaults
+    if (routing_settings_pb.pedestrian_velocity() > 0.0)
+    {
+        routing_settings.pedestrian_velocity = routing_settings_pb.pedestrian_velocity();
+    }
+    if (routing_settings_pb.snap_stops_count() > 0u)
+    {
+        routing_settings.snap_stops_count = routing_settings_pb.snap_stops_count();
+    }
+    routing_settings.walk_transfer_radius = routing_settings_pb.walk_transfer_radius();
+    if (routing_settings_pb.walk_transfer_max_neighbours() > 0u)
+    {
+        routing_settings.walk_transfer_max_neighbours = routing_settings_pb.walk_transfer_max_neighbours();
+    }
+    transport_router_.value()->SetSettings(routing_settings);
+}
+
+void Serializer::DeserializeIndexes()
+{
+    // Bases written before the indexes were stored have none and get them rebuilt
+    transport::TransportCatalogue::StoredIndexes stored;
+    if (transport_catalogue_serialize_.has_stops_index())
+    {
+        const auto& index_pb = transport_catalogue_serialize_.stops_index();
+        geo::GridIndex::Layout& layout = stored.stops_index.emplace();
+        layout.ref_cos_lat = index_pb.ref_cos_lat();
+        layout.min_x = index_pb.min_x();
+        layout.min_y = index_pb.min_y();
+        layout.cell_size = index_pb.cell_size();
+        layout.cols = index_pb.cols();
+        layout.rows = index_pb.rows();
+        layout.cell_start.assign(index_pb.cell_start().begin(), index_pb.cell_start().end());
+        layout.cell_points.assign(index_pb.cell_points().begin(), index_pb.cell_points().end());
+    }
+
+    const auto& stops_by_name_pb = transport_catalogue_serialize_.stops_by_name();
+    const auto& buses_by_name_pb = transport_catalogue_serialize_.buses_by_name();
+    stored.stops_by_name.assign(stops_by_name_pb.begin(), stops_by_name_pb.end());
+    stored.buses_by_name.assign(buses_by_name_pb.begin(), buses_by_name_pb.end());
 
-    transport_router_.value()->FillGraph(transport_catalogue_);
-    transport_router_.value()->BuildGraph();
-    transport_router_.value()->BuildRouter();
+    transport_catalogue_.BuildIndexes(move(stored));
 }
 
 svg::Color Serializer::DeserializeColor(const transport_catalogue_serialize::Color& color_pb)
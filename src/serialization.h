@@ -6,6 +6,7 @@
 
 #include <fstream>
 #include <filesystem>
+#include <google/protobuf/arena.h>
 #include <transport_catalogue.pb.h>
 #include <optional>
 
@@ -15,10 +16,10 @@ namespace serialize
 class Serializer
 {
 public:
-    Serializer(transport::TransportCatalogue& transport_catalogue, renderer::MapRenderer& map_renderer)
-        : transport_catalogue_(transport_catalogue), map_renderer_(map_renderer) {}
+    Serializer(transport::TransportCatalogue& transport_catalogue, renderer::MapRenderer& map_renderer);
 
     void Serialize();
+    // Loads data and settings; building the router graph is left to the caller
     void Deserialize();
 
     void SetFileName(const std::string& filename);
@@ -29,6 +30,9 @@ private:
     void SerializeDistance();
     void SerializeRenderSettings();
     void SerializeRoutingSettings();
+    void SerializeStopsIndex();
+    void SerializeNameIndexes();
+    void SerializeNamesHashes();
     transport_catalogue_serialize::Color SerializeColor(const svg::Color& color);
 
     void DeserializeStop();
@@ -36,9 +40,14 @@ private:
     void DeserializeDistance();
     void DeserializeRenderSettings();
     void DeserializeRoutingSettings();
+    void DeserializeIndexes();
     svg::Color DeserializeColor(const transport_catalogue_serialize::Color& color_pb);
 private:
-    transport_catalogue_serialize::TransportCatalogue transport_catalogue_serialize_;
+    // Only the message and its parts live on the arena, freed with it at once, so a serializer
+    // is meant to last for one Serialize or Deserialize. The catalogue and router it reads or
+    // fills allocate from the global heap as before
+    google::protobuf::Arena arena_;
+    transport_catalogue_serialize::TransportCatalogue& transport_catalogue_serialize_;
     transport::TransportCatalogue& transport_catalogue_;
     std::optional<transport::Router*> transport_router_;
     renderer::MapRenderer& map_renderer_;
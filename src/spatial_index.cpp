@@ -0,0 +1,250 @@
+#include "spatial_index.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace geo
+{
+	namespace
+	{
+		constexpr double DR = 3.1415926535 / 180.;
+		constexpr double EARTH_RADIUS = 6371000.0;
+		constexpr int MAX_GRID_SIDE = 4096;
+		constexpr double PROJECTION_SLACK = 1.05;
+	}
+
+	void GridIndex::Build(const std::vector<Coordinates>& points)
+	{
+		Clear();
+		if (points.empty()) { return; }
+
+		points_ = points;
+
+		double lat_sum = 0.0;
+		for (const auto& point : points_)
+		{
+			lat_sum += point.lat;
+		}
+		ref_cos_lat_ = std::cos(lat_sum / points_.size() * DR);
+
+		std::vector<Projected> projected;
+		projected.reserve(points_.size());
+		for (const auto& point : points_)
+		{
+			projected.push_back(Project(point));
+		}
+
+		const auto [min_x_it, max_x_it] = std::minmax_element(projected.begin(), projected.end(),
+			[](const Projected& lhs, const Projected& rhs) { return lhs.x < rhs.x; });
+		const auto [min_y_it, max_y_it] = std::minmax_element(projected.begin(), projected.end(),
+			[](const Projected& lhs, const Projected& rhs) { return lhs.y < rhs.y; });
+		min_x_ = min_x_it->x;
+		min_y_ = min_y_it->y;
+		const double width = max_x_it->x - min_x_;
+		const double height = max_y_it->y - min_y_;
+
+		// About one point per cell on a uniform network
+		cell_size_ = std::max(MIN_CELL_SIZE, std::sqrt(width * height / points_.size()));
+		cell_size_ = std::max({ cell_size_, width / MAX_GRID_SIDE, height / MAX_GRID_SIDE });
+		cols_ = static_cast<int>(width / cell_size_) + 1;
+		rows_ = static_cast<int>(height / cell_size_) + 1;
+
+		std::vector<uint32_t> point_cells;
+		point_cells.reserve(projected.size());
+		cell_start_.assign(static_cast<size_t>(cols_) * rows_ + 1u, 0u);
+		for (const auto& point : projected)
+		{
+			const uint32_t cell = static_cast<uint32_t>(CellRow(point.y) * cols_ + CellCol(point.x));
+			point_cells.push_back(cell);
+			++cell_start_[cell + 1u];
+		}
+		for (size_t i = 1u; i < cell_start_.size(); ++i)
+		{
+			cell_start_[i] += cell_start_[i - 1u];
+		}
+
+		cell_points_.resize(points_.size());
+		std::vector<uint32_t> fill(cell_start_.begin(), cell_start_.end() - 1);
+		for (uint32_t id = 0u; id < point_cells.size(); ++id)
+		{
+			cell_points_[fill[point_cells[id]]++] = id;
+		}
+	}
+
+	bool GridIndex::Restore(const std::vector<Coordinates>& points, Layout&& layout)
+	{
+		Clear();
+		if (points.empty() || layout.cols <= 0 || layout.rows <= 0 || !(layout.cell_size > 0.0)
+			|| layout.cell_start.size() != static_cast<size_t>(layout.cols) * layout.rows + 1u
+			|| layout.cell_start.front() != 0u || layout.cell_start.back() != points.size()
+			|| layout.cell_points.size() != points.size()
+			|| !std::is_sorted(layout.cell_start.begin(), layout.cell_start.end())
+			|| std::any_of(layout.cell_points.begin(), layout.cell_points.end(),
+				[&points](uint32_t id) { return id >= points.size(); }))
+		{
+			return false;
+		}
+
+		points_ = points;
+		ref_cos_lat_ = layout.ref_cos_lat;
+		min_x_ = layout.min_x;
+		min_y_ = layout.min_y;
+		cell_size_ = layout.cell_size;
+		cols_ = layout.cols;
+		rows_ = layout.rows;
+		cell_start_ = std::move(layout.cell_start);
+		cell_points_ = std::move(layout.cell_points);
+		return true;
+	}
+
+	GridIndex::Layout GridIndex::GetLayout() const
+	{
+		return { ref_cos_lat_, min_x_, min_y_, cell_size_, cols_, rows_, cell_start_, cell_points_ };
+	}
+
+	void GridIndex::Clear()
+	{
+		points_.clear();
+		cell_start_.clear();
+		cell_points_.clear();
+		cols_ = rows_ = 0;
+	}
+
+	bool GridIndex::Empty() const
+	{
+		return points_.empty();
+	}
+
+	size_t GridIndex::Size() const
+	{
+		return points_.size();
+	}
+
+	memory::Report GridIndex::MemoryReport() const
+	{
+		return {
+			memory::Of("points", points_),
+			memory::Of("cell_start", cell_start_),
+			memory::Of("cell_points", cell_points_)
+		};
+	}
+
+	std::vector<GridIndex::Entry> GridIndex::FindNearest(Coordinates point, size_t count) const
+	{
+		if (Empty() || count == 0u) { return {}; }
+
+		const Projected p = Project(point);
+		const int col = static_cast<int>(std::floor((p.x - min_x_) / cell_size_));
+		const int row = static_cast<int>(std::floor((p.y - min_y_) / cell_size_));
+		const int max_ring = std::max({ col, cols_ - 1 - col, row, rows_ - 1 - row, 0 });
+
+		// Rings are visited until no unvisited cell can hold a point closer than
+		// the current k-th candidate; the slack covers the projection error
+		std::vector<Entry> candidates;
+		for (int ring = 0; ring <= max_ring; ++ring)
+		{
+			VisitRing(col, row, ring, [&](uint32_t id) {
+				const Projected q = Project(points_[id]);
+				candidates.push_back({ id, std::hypot(q.x - p.x, q.y - p.y) });
+			});
+			if (candidates.size() >= count)
+			{
+				std::nth_element(candidates.begin(), candidates.begin() + (count - 1u), candidates.end(),
+					[](const Entry& lhs, const Entry& rhs) { return lhs.distance < rhs.distance; });
+				if (candidates[count - 1u].distance * PROJECTION_SLACK <= DistanceOutsideRing(p, col, row, ring))
+				{
+					break;
+				}
+			}
+		}
+
+		for (auto& entry : candidates)
+		{
+			entry.distance = ComputeDistance(point, points_[entry.id]);
+		}
+		const size_t result_size = std::min(count, candidates.size());
+		std::partial_sort(candidates.begin(), candidates.begin() + result_size, candidates.end(),
+			[](const Entry& lhs, const Entry& rhs) { return lhs.distance < rhs.distance; });
+		candidates.resize(result_size);
+
+		return candidates;
+	}
+
+	std::vector<GridIndex::Entry> GridIndex::FindWithinRadius(Coordinates point, double radius) const
+	{
+		std::vector<Entry> result;
+		if (Empty() || radius < 0.0) { return result; }
+
+		const Projected p = Project(point);
+		const double reach = radius * PROJECTION_SLACK;
+		const int col_from = CellCol(p.x - reach);
+		const int col_to = CellCol(p.x + reach);
+		const int row_from = CellRow(p.y - reach);
+		const int row_to = CellRow(p.y + reach);
+
+		for (int row = row_from; row <= row_to; ++row)
+		{
+			for (int col = col_from; col <= col_to; ++col)
+			{
+				const size_t cell = static_cast<size_t>(row) * cols_ + col;
+				for (uint32_t i = cell_start_[cell]; i < cell_start_[cell + 1u]; ++i)
+				{
+					const uint32_t id = cell_points_[i];
+					const double distance = ComputeDistance(point, points_[id]);
+					if (distance <= radius)
+					{
+						result.push_back({ id, distance });
+					}
+				}
+			}
+		}
+
+		std::sort(result.begin(), result.end(),
+			[](const Entry& lhs, const Entry& rhs) { return lhs.distance < rhs.distance; });
+		return result;
+	}
+
+	GridIndex::Projected GridIndex::Project(Coordinates point) const
+	{
+		return { point.lng * DR * EARTH_RADIUS * ref_cos_lat_, point.lat * DR * EARTH_RADIUS };
+	}
+
+	int GridIndex::CellCol(double x) const
+	{
+		return std::clamp(static_cast<int>(std::floor((x - min_x_) / cell_size_)), 0, cols_ - 1);
+	}
+
+	int GridIndex::CellRow(double y) const
+	{
+		return std::clamp(static_cast<int>(std::floor((y - min_y_) / cell_size_)), 0, rows_ - 1);
+	}
+
+	double GridIndex::DistanceOutsideRing(const Projected& point, int col, int row, int ring) const
+	{
+		const double left = min_x_ + (col - ring) * cell_size_;
+		const double right = min_x_ + (col + ring + 1) * cell_size_;
+		const double bottom = min_y_ + (row - ring) * cell_size_;
+		const double top = min_y_ + (row + ring + 1) * cell_size_;
+		return std::min({ point.x - left, right - point.x, point.y - bottom, top - point.y });
+	}
+
+	template <typename Visitor>
+	void GridIndex::VisitRing(int col, int row, int ring, Visitor&& visitor) const
+	{
+		for (int r = row - ring; r <= row + ring; ++r)
+		{
+			if (r < 0 || r >= rows_) { continue; }
+			const bool edge_row = (r == row - ring || r == row + ring);
+			const int step = edge_row ? 1 : std::max(1, 2 * ring);
+			for (int c = col - ring; c <= col + ring; c += step)
+			{
+				if (c < 0 || c >= cols_) { continue; }
+				const size_t cell = static_cast<size_t>(r) * cols_ + c;
+				for (uint32_t i = cell_start_[cell]; i < cell_start_[cell + 1u]; ++i)
+				{
+					visitor(cell_points_[i]);
+				}
+			}
+		}
+	}
+}
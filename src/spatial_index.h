@@ -0,0 +1,84 @@
+#pragma once
+
+#include "geo.h"
+#include "memory_report.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace geo
+{
+	// Uniform grid over equirectangular-projected coordinates.
+	// Points are bucketed by cell (CSR layout), queries visit only the cells
+	// around the requested point. Reported distances are great-circle ones.
+	class GridIndex
+	{
+	public:
+		struct Entry
+		{
+			size_t id = 0u;
+			double distance = 0.0;
+		};
+
+		// Everything Build derives from the points, so a stored index can be restored as is
+		struct Layout
+		{
+			double ref_cos_lat = 1.0;
+			double min_x = 0.0;
+			double min_y = 0.0;
+			double cell_size = 0.0;
+			int cols = 0;
+			int rows = 0;
+			std::vector<uint32_t> cell_start;
+			std::vector<uint32_t> cell_points;
+		};
+
+		GridIndex() = default;
+
+		// ids of the points are their positions in `points`
+		void Build(const std::vector<Coordinates>& points);
+		// Takes a layout made by GetLayout for the same points; false (and the index
+		// left empty) if the layout does not fit them
+		bool Restore(const std::vector<Coordinates>& points, Layout&& layout);
+		Layout GetLayout() const;
+		void Clear();
+
+		bool Empty() const;
+		size_t Size() const;
+
+		// Up to `count` nearest points, ordered by distance
+		std::vector<Entry> FindNearest(Coordinates point, size_t count) const;
+		// All points not further than `radius` metres, ordered by distance
+		std::vector<Entry> FindWithinRadius(Coordinates point, double radius) const;
+
+		memory::Report MemoryReport() const;
+
+	private:
+		struct Projected
+		{
+			double x = 0.0;
+			double y = 0.0;
+		};
+
+		static constexpr double MIN_CELL_SIZE = 100.0;  // metres
+
+		Projected Project(Coordinates point) const;
+		int CellCol(double x) const;
+		int CellRow(double y) const;
+		double DistanceOutsideRing(const Projected& point, int col, int row, int ring) const;
+
+		template <typename Visitor>
+		void VisitRing(int col, int row, int ring, Visitor&& visitor) const;
+
+		double ref_cos_lat_ = 1.0;
+		double min_x_ = 0.0;
+		double min_y_ = 0.0;
+		double cell_size_ = MIN_CELL_SIZE;
+		int cols_ = 0;
+		int rows_ = 0;
+
+		std::vector<Coordinates> points_;
+		std::vector<uint32_t> cell_start_;  // cols_ * rows_ + 1 offsets into cell_points_
+		std::vector<uint32_t> cell_points_;
+	};
+}
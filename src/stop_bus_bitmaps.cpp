@@ -0,0 +1,50 @@
+#include "stop_bus_bitmaps.h"
+
+namespace transport
+{
+	void StopBusBitmaps::Build(const domain::StopsTable& stops, const std::vector<domain::BusId>& buses_by_name)
+	{
+		std::vector<uint32_t> ranks(buses_by_name.size());
+		for (uint32_t rank = 0u; rank < buses_by_name.size(); ++rank)
+		{
+			ranks[buses_by_name[rank]] = rank;
+		}
+
+		// Passing buses are in name order, so a stop's first and last bus give its span
+		const size_t stops_count = stops.passing_bus_begins.empty() ? 0u : stops.passing_bus_begins.size() - 1u;
+		word_begins_.assign(1u, 0u);
+		word_begins_.reserve(stops_count + 1u);
+		first_words_.clear();
+		first_words_.reserve(stops_count);
+		words_.clear();
+		for (size_t stop = 0u; stop < stops_count; ++stop)
+		{
+			const domain::BusId* begin = stops.passing_buses.data() + stops.passing_bus_begins[stop];
+			const domain::BusId* end = stops.passing_buses.data() + stops.passing_bus_begins[stop + 1u];
+			const uint32_t first_word = (begin == end) ? 0u : ranks[*begin] / 64u;
+			const uint32_t last_word = (begin == end) ? 0u : ranks[*(end - 1)] / 64u;
+
+			const size_t offset = words_.size();
+			if (begin != end)
+			{
+				words_.resize(offset + last_word - first_word + 1u, 0u);
+			}
+			for (const domain::BusId* bus = begin; bus != end; ++bus)
+			{
+				const uint32_t rank = ranks[*bus];
+				words_[offset + rank / 64u - first_word] |= uint64_t{ 1u } << (rank % 64u);
+			}
+			first_words_.push_back(first_word);
+			word_begins_.push_back(static_cast<uint32_t>(words_.size()));
+		}
+	}
+
+	memory::Report StopBusBitmaps::MemoryReport() const
+	{
+		return {
+			memory::Of("word_begins", word_begins_),
+			memory::Of("first_words", first_words_),
+			memory::Of("words", words_)
+		};
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "domain.h"
+#include "memory_report.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace transport
+{
+	// The buses passing every stop as bits over bus name ranks, so that the buses two stops share
+	// are one AND of their words and come out in name order. A stop keeps only the span of 64-bit
+	// words from its first to its last set bit: a stop of few buses takes a word or two, a hub
+	// a dense run
+	class StopBusBitmaps
+	{
+	public:
+		// Stops' passing buses are read from the table, buses_by_name gives the ranks
+		void Build(const domain::StopsTable& stops, const std::vector<domain::BusId>& buses_by_name);
+
+		// visitor(rank) for every bus passing both stops, in ascending rank
+		template <typename Visitor>
+		void ForEachCommon(domain::StopId first, domain::StopId second, Visitor&& visitor) const
+		{
+			if (first + 1u >= word_begins_.size() || second + 1u >= word_begins_.size()) { return; }
+
+			const uint32_t begin = std::max(first_words_[first], first_words_[second]);
+			const uint32_t end = std::min(first_words_[first] + WordsCount(first), first_words_[second] + WordsCount(second));
+			// Indexed from each stop's own first word, a pointer shifted back by it could fall
+			// before words_
+			const uint32_t first_offset = word_begins_[first];
+			const uint32_t second_offset = word_begins_[second];
+			for (uint32_t word = begin; word < end; ++word)
+			{
+				const uint64_t common = words_[first_offset + (word - first_words_[first])] 
+					& words_[second_offset + (word - first_words_[second])];
+				for (uint64_t bits = common; bits != 0u; bits &= bits - 1u)
+				{
+					visitor(word * 64u + static_cast<uint32_t>(__builtin_ctzll(bits)));
+				}
+			}
+		}
+
+		memory::Report MemoryReport() const;
+
+	private:
+		// Stop i owns words_[word_begins_[i] .. word_begins_[i + 1]), the first of them being
+		// word first_words_[i] of the full bitmap
+		std::vector<uint32_t> word_begins_;
+		std::vector<uint32_t> first_words_;
+		std::vector<uint64_t> words_;
+
+		uint32_t WordsCount(domain::StopId stop) const { return word_begins_[stop + 1u] - word_begins_[stop]; }
+	};
+}
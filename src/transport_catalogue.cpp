@@ -1,116 +1,467 @@
 #include "geo.h"
+#include "parallel.h"
 #include "transport_catalogue.h"
 
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <numeric>
 #include <utility>
 #include <set>
+#include <stdexcept>
+#include <string>
 #include <cmath>
 
 namespace transport 
 {
 	using namespace domain;
+	using namespace std::literals;
 
-	size_t TransportCatalogue::StopsPairHasher::operator()(const StopsPair& stops_pair) const 
+	BusId TransportCatalogue::AddBus(Bus&& bus) 
     {
-		return {
-			hash_(stops_pair.first.get()) +
-			hash_(stops_pair.second.get()) * 37 * 37
-		};
+		if (const auto id = buses_.names.Find(bus.name)) { return *id; }
+
+		const BusId id = buses_.names.Add(bus.name);
+		AppendBusColumns(bus);
+		return id;
 	}
 
-	void TransportCatalogue::AddBus(Bus&& bus) 
+	StopId TransportCatalogue::AddStop(Stop&& stop) 
     {
-		buses_.push_back(std::make_shared<Bus>(std::move(bus)));
-		const auto bus_ptr = buses_.back().get();
-		name_to_bus_[*bus_ptr->name.get()] = buses_.back();
+		if (const auto id = stops_.names.Find(stop.name)) { return *id; }
 
-		AddToStopPassingBuses(bus_ptr->route, *bus_ptr->name.get());
+		const StopId id = stops_.names.Add(stop.name);
+		AppendStopColumns(stop);
+		return id;
 	}
 
-	void TransportCatalogue::AddStop(Stop&& stop) 
+	void TransportCatalogue::AddStoredStops(std::vector<Stop>&& stops, std::optional<PerfectHash::Layout>&& names_hash) 
     {
-		if (name_to_stop_.count(*stop.name.get())) { return; }
-
-		stops_.push_back(std::make_shared<Stop>(std::move(stop)));
-		const auto stop_ptr = stops_.back().get();
-		name_to_stop_[*stop_ptr->name.get()] = stops_.back();
+		for (const Stop& stop : stops) 
+        {
+			stops_.names.AddStored(stop.name);
+			AppendStopColumns(stop);
+		}
+		stops_.names.RestorePerfectHash(std::move(names_hash));
+	}
 
-		stops_pair_to_distance_[{ stops_.back(), stops_.back() }] = 0;
+	void TransportCatalogue::AddStoredBuses(std::vector<Bus>&& buses, std::optional<PerfectHash::Layout>&& names_hash) 
+    {
+		for (const Bus& bus : buses) 
+        {
+			buses_.names.AddStored(bus.name);
+			AppendBusColumns(bus);
+		}
+		buses_.names.RestorePerfectHash(std::move(names_hash));
 	}
 
 	void TransportCatalogue::SetDistanceBetweenStops(const std::string_view first, const std::string_view second, double distance) 
     {
-		StopPointer stop_X = FindStop(first);
-		StopPointer stop_To = FindStop(second);
+		const StopView from = FindStop(first);
+		const StopView to = FindStop(second);
+		if (!from || !to) 
+        {
+			throw std::invalid_argument("Unknown stop \""s + std::string(from ? second : first) + "\" in road distances"s);
+		}
+		distances_.Set(from.Id(), to.Id(), static_cast<int>(distance));
+	}
 
-		stops_pair_to_distance_[{stop_X, stop_To}] = distance;
-		StopsPair tmp_pair = { stop_To, stop_X };
+	void TransportCatalogue::BuildIndexes() 
+    {
+		BuildIndexes({});
+	}
 
-		if (stops_pair_to_distance_.count(tmp_pair) == 0u) {
-			stops_pair_to_distance_[move(tmp_pair)] = distance;
+	void TransportCatalogue::BuildIndexes(StoredIndexes&& stored) 
+    {
+		// No-ops for names whose perfect hash came with a base
+		stops_.names.BuildPerfectHash();
+		buses_.names.BuildPerfectHash();
+		if (!stored.stops_index || !stops_index_.Restore(stops_.coords, std::move(*stored.stops_index))) 
+        {
+			stops_index_.Build(stops_.coords);
+		}
+		if (!stops_by_name_.Restore(stops_.names, std::move(stored.stops_by_name))) 
+        {
+			stops_by_name_.Build(stops_.names);
 		}
+		if (!buses_by_name_.Restore(buses_.names, std::move(stored.buses_by_name))) 
+        {
+			buses_by_name_.Build(buses_.names);
+		}
+
+		BuildPassingBuses();
+		stop_buses_.Build(stops_, buses_by_name_.Order());
+	}
+
+	size_t TransportCatalogue::GetStopCount() const 
+    {
+		return stops_.names.Size();
+	}
+
+	size_t TransportCatalogue::GetBusCount() const 
+    {
+		return buses_.names.Size();
+	}
+
+	StopView TransportCatalogue::GetStop(StopId id) const 
+    {
+		return { &stops_, id };
 	}
 
-	BusPointer TransportCatalogue::FindBus(const std::string_view name) const 
+	BusView TransportCatalogue::GetBus(BusId id) const 
     {
-		return (name_to_bus_.count(name) ? name_to_bus_.at(name) : nullptr);
+		return { &buses_, &stops_, id };
 	}
 
-	StopPointer TransportCatalogue::FindStop(const std::string_view name) const 
+	StopView TransportCatalogue::FindStop(const std::string_view name) const 
     {
-		return (name_to_stop_.count(name) ? name_to_stop_.at(name) : nullptr);
+		const auto id = stops_.names.Find(name);
+		return id ? GetStop(*id) : StopView{};
+	}
+
+	BusView TransportCatalogue::FindBus(const std::string_view name) const 
+    {
+		const auto id = buses_.names.Find(name);
+		return id ? GetBus(*id) : BusView{};
+	}
+
+	std::optional<double> TransportCatalogue::GetActualDistance(StopId from, StopId to) const 
+    {
+		if (const auto distance = distances_.Find(from, to)) 
+        {
+			return *distance;
+		}
+		if (const auto distance = distances_.Find(to, from)) 
+        {
+			return *distance;
+		}
+		return (from == to) ? std::optional<double>(0.0) : std::nullopt;
 	}
 
 	std::optional<double> TransportCatalogue::GetActualDistanceBetweenStops(const std::string_view stop1_name, const std::string_view stop2_name) const 
     {
-		StopPointer first_stop = FindStop(stop1_name);
-		StopPointer second_stop = FindStop(stop2_name);
-		if (first_stop.get() == nullptr || second_stop.get() == nullptr) 
+		const StopView first_stop = FindStop(stop1_name);
+		const StopView second_stop = FindStop(stop2_name);
+		if (!first_stop || !second_stop) 
         {
 			return {};
 		}
-		const StopsPair tmp_pair = { first_stop, second_stop };
 
-		return (stops_pair_to_distance_.count(tmp_pair) ? stops_pair_to_distance_.at(tmp_pair) : std::optional<double>{});
+		return GetActualDistance(first_stop.Id(), second_stop.Id());
 	}
 
 	std::optional<double> TransportCatalogue::GetGeographicDistanceBetweenStops(const std::string_view stop1_name, const std::string_view stop2_name) const 
     {
-		StopPointer first_stop = FindStop(stop1_name);
-		StopPointer second_stop = FindStop(stop2_name);
-		if (first_stop == nullptr || second_stop == nullptr) 
+		const StopView first_stop = FindStop(stop1_name);
+		const StopView second_stop = FindStop(stop2_name);
+		if (!first_stop || !second_stop) 
         {
 			return {};
 		}
 
-		return first_stop->GetGeographicDistanceTo(second_stop);
+		const StopId route[] = { first_stop.Id(), second_stop.Id() };
+		return ComputeGeographicLength(MakeRouteStops(route, 2u, true), geo::DistanceMode::EXACT);
+	}
+
+	double TransportCatalogue::ComputeGeographicLength(RouteStops route, geo::DistanceMode mode) const 
+    {
+		thread_local std::vector<geo::Coordinates> points;
+		thread_local std::vector<geo::LatitudeTrig> trigs;
+		points.clear();
+		trigs.clear();
+		for (const StopId stop : route) 
+        {
+			points.push_back(stops_.coords[stop]);
+			trigs.push_back(stops_.lat_trigs[stop]);
+		}
+		return geo::ComputePathLength(points.data(), trigs.data(), points.size(), mode);
+	}
+
+	int TransportCatalogue::ComputeActualLength(RouteStops route) const 
+    {
+		int length = 0;
+		for (auto it = route.begin(); it != route.end() && it + 1 != route.end(); ++it) 
+        {
+			length += static_cast<int>(GetActualDistance(*it, *(it + 1)).value_or(0.0));
+		}
+		return length;
+	}
+
+	void TransportCatalogue::ComputeBusStats(std::vector<Bus>& buses, geo::DistanceMode mode) const 
+    {
+		// Fewer buses than this per thread do not pay for starting one
+		static const size_t min_buses_per_thread = 64u;
+
+		// Route lengths vary a lot, so threads take buses one by one rather than in chunks
+		std::atomic<size_t> next_bus{ 0u };
+		parallel::Run(parallel::ThreadsFor(buses.size(), min_buses_per_thread), [&](size_t) 
+        {
+			std::vector<bool> seen(GetStopCount(), false);
+			for (size_t i = next_bus++; i < buses.size(); i = next_bus++) 
+            {
+				Bus& bus = buses[i];
+				const RouteStops route = MakeRouteStops(bus.route.data(), bus.route.size(), bus.roundtrip);
+				int unique_stops = 0;
+				for (const StopId stop : bus.route) 
+                {
+					if (!seen[stop]) 
+                    {
+						seen[stop] = true;
+						++unique_stops;
+					}
+				}
+				for (const StopId stop : bus.route) 
+                {
+					seen[stop] = false;
+				}
+				bus.unique_stops = unique_stops;
+				bus.route_geographic_length = ComputeGeographicLength(route, mode);
+				bus.route_actual_length = ComputeActualLength(route);
+			}
+		});
+	}
+
+	ranges::Range<const BusId*> TransportCatalogue::GetPassingBusesByStop(StopId stop) const 
+    {
+		return GetStop(stop).PassingBuses();
+	}
+
+	const std::vector<StopId>& TransportCatalogue::GetStopsByName() const 
+    {
+		return stops_by_name_.Order();
+	}
+
+	const std::vector<BusId>& TransportCatalogue::GetBusesByName() const 
+    {
+		return buses_by_name_.Order();
+	}
+
+	PerfectHash::Layout TransportCatalogue::GetStopNamesHash() const 
+    {
+		return stops_.names.GetPerfectHashLayout();
+	}
+
+	PerfectHash::Layout TransportCatalogue::GetBusNamesHash() const 
+    {
+		return buses_.names.GetPerfectHashLayout();
+	}
+
+	std::vector<StopId> TransportCatalogue::SearchStops(std::string_view query, size_t max_edits, bool as_prefix) const 
+    {
+		return stops_by_name_.FindSimilar(stops_.names, query, max_edits, as_prefix);
+	}
+
+	std::vector<BusId> TransportCatalogue::SearchBuses(std::string_view query, size_t max_edits, bool as_prefix) const 
+    {
+		return buses_by_name_.FindSimilar(buses_.names, query, max_edits, as_prefix);
+	}
+
+	std::vector<BusId> TransportCatalogue::FindDirectBuses(StopId from, StopId to, bool ordered) const 
+    {
+		const std::vector<BusId>& by_name = buses_by_name_.Order();
+		std::vector<BusId> result;
+		stop_buses_.ForEachCommon(from, to, [&](uint32_t rank) 
+        {
+			const BusId bus = by_name[rank];
+			if (ordered) 
+            {
+				const RouteStops route = GetBus(bus).Route();
+				const auto from_it = std::find(route.begin(), route.end(), from);
+				if (from_it == route.end() || std::find(from_it + 1, route.end(), to) == route.end()) { return; }
+			}
+			result.push_back(bus);
+		});
+		return result;
+	}
+
+	NetworkAnalytics TransportCatalogue::ComputeAnalytics(const AnalyticsOptions& options) const 
+    {
+		// Single passes over the stats columns, cheap next to anything read from the routes table
+		NetworkAnalytics result;
+		if (options.route_length) 
+        {
+			result.route_length = std::accumulate(buses_.route_actual_lengths.begin(), buses_.route_actual_lengths.end(), 0.0);
+			result.geographic_length = std::accumulate(buses_.route_geographic_lengths.begin(), buses_.route_geographic_lengths.end(), 0.0);
+		}
+		if (options.curvature) 
+        {
+			std::vector<double> curvatures;
+			curvatures.reserve(GetBusCount());
+			for (BusId bus = 0u; bus < GetBusCount(); ++bus) 
+            {
+				if (buses_.route_geographic_lengths[bus] > 0.0) 
+                {
+					curvatures.push_back(buses_.route_actual_lengths[bus] / buses_.route_geographic_lengths[bus]);
+				}
+			}
+			result.curvature = MakeDistribution(curvatures);
+		}
+		if (options.busiest_stops > 0u) 
+        {
+			// Stops in name order, so a stable sort by bus count keeps ties in name order
+			const std::vector<StopId>& by_name = GetStopsByName();
+			result.busiest_stops.reserve(by_name.size());
+			for (const StopId stop : by_name) 
+            {
+				result.busiest_stops.push_back({ stop, GetStop(stop).PassingBuses().size() });
+			}
+			std::stable_sort(result.busiest_stops.begin(), result.busiest_stops.end(), 
+				[](const BusiestStop& lhs, const BusiestStop& rhs) { return lhs.bus_count > rhs.bus_count; });
+			result.busiest_stops.resize(std::min(options.busiest_stops, result.busiest_stops.size()));
+		}
+		return result;
+	}
+
+	StopViews TransportCatalogue::GetStops() const 
+    {
+		return ranges::Transform(ranges::Iota(StopId{ 0u }, static_cast<StopId>(GetStopCount())), MakeStopView{ &stops_ });
 	}
 
-	const std::unordered_set<BusPointer>* TransportCatalogue::GetPassingBusesByStop(StopPointer stop) const 
+	BusViews TransportCatalogue::GetBuses() const 
     {
-		return ((stop_to_passing_buses_.count(stop)) ? &stop_to_passing_buses_.at(stop) : nullptr);
+		return ranges::Transform(ranges::Iota(BusId{ 0u }, static_cast<BusId>(GetBusCount())), MakeBusView{ &buses_, &stops_ });
 	}
 
-	const std::vector<BusPointer> TransportCatalogue::GetBusesInVector() const 
+	StopViewsByName TransportCatalogue::GetStopsSortedByName() const 
     {
-		return std::vector<BusPointer>(buses_.begin(), buses_.end());
+		const std::vector<StopId>& order = GetStopsByName();
+		return ranges::Transform(ranges::Range<const StopId*>(order.data(), order.data() + order.size()), MakeStopView{ &stops_ });
 	}
 
-	const std::vector<StopPointer> TransportCatalogue::GetStopsInVector() const 
+	BusViewsByName TransportCatalogue::GetBusesSortedByName() const 
     {
-		return std::vector<StopPointer>(stops_.begin(), stops_.end());
+		const std::vector<BusId>& order = GetBusesByName();
+		return ranges::Transform(ranges::Range<const BusId*>(order.data(), order.data() + order.size()), MakeBusView{ &buses_, &stops_ });
+	}
+
+	geo::DistanceMode TransportCatalogue::GetGeographicLengthMode() const
+	{
+		return length_mode_;
 	}
 
-	const std::unordered_map<TransportCatalogue::StopsPair, int, TransportCatalogue::StopsPairHasher> TransportCatalogue::GetStopPairsToDistance() const
+	void TransportCatalogue::SetGeographicLengthMode(geo::DistanceMode mode)
 	{
-		return std::unordered_map<StopsPair, int, StopsPairHasher>(stops_pair_to_distance_.begin(), stops_pair_to_distance_.end());
+		length_mode_ = mode;
 	}
 
-	void TransportCatalogue::AddToStopPassingBuses(const std::vector<StopPointer>& stops, const std::string_view bus_name) 
+	const DistanceTable& TransportCatalogue::GetDistances() const
+	{
+		return distances_;
+	}
+
+	std::vector<NearbyStop> TransportCatalogue::FindNearestStops(geo::Coordinates point, size_t count) const 
     {
-		BusPointer bus = FindBus(bus_name);
-		for (size_t i = 0u; i < stops.size(); ++i) 
+		return ToNearbyStops(stops_index_.FindNearest(point, count));
+	}
+
+	std::vector<NearbyStop> TransportCatalogue::FindStopsWithinRadius(geo::Coordinates point, double radius) const 
+    {
+		return ToNearbyStops(stops_index_.FindWithinRadius(point, radius));
+	}
+
+	std::vector<NearbyStop> TransportCatalogue::FindNearestStopsWithinRadius(geo::Coordinates point, size_t count, double radius) const 
+    {
+		std::vector<geo::GridIndex::Entry> entries = stops_index_.FindNearest(point, count);
+		const auto outside = std::find_if(entries.begin(), entries.end(), 
+			[radius](const geo::GridIndex::Entry& entry) { return entry.distance > radius; });
+		entries.erase(outside, entries.end());
+		return ToNearbyStops(entries);
+	}
+
+	const geo::GridIndex& TransportCatalogue::GetStopsIndex() const 
+    {
+		return stops_index_;
+	}
+
+	memory::Report TransportCatalogue::MemoryReport() const 
+    {
+		memory::Report report;
+		memory::Append(report, "stops.names", stops_.names.MemoryReport());
+		report.push_back(memory::Of("stops.coords", stops_.coords));
+		report.push_back(memory::Of("stops.lat_trigs", stops_.lat_trigs));
+		report.push_back(memory::Of("stops.passing_bus_begins", stops_.passing_bus_begins));
+		report.push_back(memory::Of("stops.passing_buses", stops_.passing_buses));
+
+		memory::Append(report, "buses.names", buses_.names.MemoryReport());
+		report.push_back(memory::Of("buses.route_begins", buses_.route_begins));
+		report.push_back(memory::Of("buses.route_stops", buses_.route_stops));
+		report.push_back(memory::Of("buses.unique_stops", buses_.unique_stops));
+		report.push_back(memory::Of("buses.route_actual_lengths", buses_.route_actual_lengths));
+		report.push_back(memory::Of("buses.route_geographic_lengths", buses_.route_geographic_lengths));
+		report.push_back(memory::Of("buses.roundtrips", buses_.roundtrips));
+		report.push_back(memory::Of("buses.last_stops", buses_.last_stops));
+
+		memory::Append(report, "stops_by_name", stops_by_name_.MemoryReport());
+		memory::Append(report, "buses_by_name", buses_by_name_.MemoryReport());
+		memory::Append(report, "distances", distances_.MemoryReport());
+		memory::Append(report, "stops_index", stops_index_.MemoryReport());
+		memory::Append(report, "stop_buses", stop_buses_.MemoryReport());
+		return report;
+	}
+
+	std::vector<NearbyStop> TransportCatalogue::ToNearbyStops(const std::vector<geo::GridIndex::Entry>& entries) const 
+    {
+		std::vector<NearbyStop> result;
+		result.reserve(entries.size());
+		for (const auto& entry : entries) 
+        {
+			result.push_back({ static_cast<StopId>(entry.id), entry.distance });
+		}
+		return result;
+	}
+
+	void TransportCatalogue::AppendStopColumns(const Stop& stop) 
+    {
+		stops_.coords.push_back(stop.coords);
+		stops_.lat_trigs.push_back(geo::ComputeLatitudeTrig(stop.coords));
+	}
+
+	void TransportCatalogue::AppendBusColumns(const Bus& bus) 
+    {
+		buses_.route_stops.insert(buses_.route_stops.end(), bus.route.begin(), bus.route.end());
+		buses_.route_begins.push_back(static_cast<uint32_t>(buses_.route_stops.size()));
+		buses_.unique_stops.push_back(bus.unique_stops);
+		buses_.route_actual_lengths.push_back(bus.route_actual_length);
+		buses_.route_geographic_lengths.push_back(bus.route_geographic_length);
+		buses_.roundtrips.push_back(bus.roundtrip);
+		buses_.last_stops.push_back(bus.last_stop);
+	}
+
+	void TransportCatalogue::BuildPassingBuses() 
+    {
+		// Buses are visited in name order, so every stop's segment comes out sorted.
+		// last_bus[stop] skips the repeated visits of one bus to the same stop
+		std::vector<BusId> last_bus(GetStopCount(), std::numeric_limits<BusId>::max());
+		stops_.passing_bus_begins.assign(GetStopCount() + 1u, 0u);
+		for (const BusId bus : buses_by_name_.Order()) 
+        {
+			for (const StopId stop : GetBus(bus).StoredStops()) 
+            {
+				if (last_bus[stop] != bus) 
+                {
+					last_bus[stop] = bus;
+					++stops_.passing_bus_begins[stop + 1u];
+				}
+			}
+		}
+		for (size_t i = 1u; i < stops_.passing_bus_begins.size(); ++i) 
+        {
+			stops_.passing_bus_begins[i] += stops_.passing_bus_begins[i - 1u];
+		}
+
+		stops_.passing_buses.resize(stops_.passing_bus_begins.back());
+		std::vector<uint32_t> fill(stops_.passing_bus_begins.begin(), stops_.passing_bus_begins.end() - 1);
+		std::fill(last_bus.begin(), last_bus.end(), std::numeric_limits<BusId>::max());
+		for (const BusId bus : buses_by_name_.Order()) 
         {
-			stop_to_passing_buses_[stops[i]].insert(bus);
+			for (const StopId stop : GetBus(bus).StoredStops()) 
+            {
+				if (last_bus[stop] != bus) 
+                {
+					last_bus[stop] = bus;
+					stops_.passing_buses[fill[stop]++] = bus;
+				}
+			}
 		}
 	}
 }
@@ -1,13 +1,16 @@
 #pragma once
 
+#include "distance_table.h"
 #include "domain.h"
+#include "memory_report.h"
+#include "name_index.h"
+#include "spatial_index.h"
+#include "stop_bus_bitmaps.h"
 
 #include <string>
 #include <vector>
 #include <string_view>
-#include <deque>
 #include <unordered_map>
-#include <unordered_set>
 #include <tuple>
 #include <optional>
 #include <memory>
@@ -17,44 +20,117 @@ namespace transport
 
 	class TransportCatalogue 
     {
-	private:
-		using StopsPair = std::pair<domain::StopPointer, domain::StopPointer>;
+	public:
+		TransportCatalogue() = default;
+		// Copies only when asked for, to start the next snapshot from the published one.
+		// Views handed out point into the catalogue's own columns, never into a copy's
+		explicit TransportCatalogue(const TransportCatalogue& other) = default;
+		TransportCatalogue& operator=(const TransportCatalogue&) = delete;
 
-		class StopsPairHasher 
-        {
-		public:
-			std::size_t operator()(const StopsPair& stops_pair) const;
+		// Writers: not safe to call concurrently with anything else.
+		// Ids are assigned densely in insertion order. A name already added keeps its first stop
+		// or bus, whose id is returned
+		domain::BusId AddBus(domain::Bus&& bus);
+		domain::StopId AddStop(domain::Stop&& stop);
+		// Throws std::invalid_argument if either stop is unknown
+		void SetDistanceBetweenStops(const std::string_view first, const std::string_view second, double distance);
+		// Loading a base into an empty catalogue: the names read back are distinct, so they are
+		// not put in a hash table but found by the perfect hash stored with them (rebuilt if it
+		// is missing or does not fit). Stops come first, as nothing is found by name before
+		void AddStoredStops(std::vector<domain::Stop>&& stops, std::optional<domain::PerfectHash::Layout>&& names_hash);
+		void AddStoredBuses(std::vector<domain::Bus>&& buses, std::optional<domain::PerfectHash::Layout>&& names_hash);
 
-		private:
-			std::hash<const void*> hash_;
+		// Indexes a base keeps next to the data; a part that is missing or does not fit is rebuilt
+		struct StoredIndexes
+		{
+			std::optional<geo::GridIndex::Layout> stops_index;
+			std::vector<domain::StopId> stops_by_name;
+			std::vector<domain::BusId> buses_by_name;
 		};
 
-	public:
-		void AddBus(domain::Bus&& bus);
-		void AddStop(domain::Stop&& stop);
-		void SetDistanceBetweenStops(const std::string_view first, const std::string_view second, double distance);
+		// Must be called once all stops and buses are added: builds the spatial index,
+		// the perfect hashes of the names and the name indexes below
+		void BuildIndexes();
+		void BuildIndexes(StoredIndexes&& stored);
 
-		domain::BusPointer FindBus(const std::string_view name)  const;
-		domain::StopPointer FindStop(const std::string_view name) const;
+		// Read-only snapshot API. Once the catalogue is filled and indexed, any number of threads
+		// may call the const methods concurrently. Views are plain handles into the catalogue's
+		// columns, valid for its lifetime; a view of an unknown name converts to false
+		size_t GetStopCount() const;
+		size_t GetBusCount() const;
+		domain::StopView GetStop(domain::StopId id) const;
+		domain::BusView GetBus(domain::BusId id) const;
+		domain::StopView FindStop(const std::string_view name) const;
+		domain::BusView FindBus(const std::string_view name) const;
 
+		// The distance set for this direction, else the one set for the reverse direction;
+		// a stop is 0 metres away from itself unless set otherwise
+		std::optional<double> GetActualDistance(domain::StopId from, domain::StopId to) const;
 		std::optional<double> GetActualDistanceBetweenStops(const std::string_view stop1_name, const std::string_view stop2_name) const;
 		std::optional<double> GetGeographicDistanceBetweenStops(const std::string_view stop1_name, const std::string_view stop2_name) const;
-		
-        const std::unordered_set<domain::BusPointer>* GetPassingBusesByStop(domain::StopPointer stop) const;
-		const std::vector<domain::BusPointer> GetBusesInVector() const;
-		const std::vector<domain::StopPointer> GetStopsInVector() const;
-		const std::unordered_map<StopsPair, int, StopsPairHasher> GetStopPairsToDistance() const;
+		// Route lengths summed over consecutive stops; the geographic one is a single pass
+		// over the cached latitude trigonometry of the route's stops
+		double ComputeGeographicLength(domain::RouteStops route, geo::DistanceMode mode) const;
+		int ComputeActualLength(domain::RouteStops route) const;
+		// Fills the unique stop count and both lengths of every bus, spread over the hardware
+		// threads. Needs every stop and distance the routes use, the buses need not be added yet
+		void ComputeBusStats(std::vector<domain::Bus>& buses, geo::DistanceMode mode) const;
+		// The mode the buses' geographic lengths were computed in, stored with the base so that
+		// buses added to it later are computed the same way. Only recorded, nothing is recomputed
+		geo::DistanceMode GetGeographicLengthMode() const;
+		void SetGeographicLengthMode(geo::DistanceMode mode);
+
+		// Ids of the buses passing the stop in bus name order, empty until the indexes are built
+		ranges::Range<const domain::BusId*> GetPassingBusesByStop(domain::StopId stop) const;
+		// All ids ordered by name, precomputed by BuildIndexes
+		const std::vector<domain::StopId>& GetStopsByName() const;
+		const std::vector<domain::BusId>& GetBusesByName() const;
+		// All stops and buses as views made on the fly, in id order or in name order
+		domain::StopViews GetStops() const;
+		domain::BusViews GetBuses() const;
+		domain::StopViewsByName GetStopsSortedByName() const;
+		domain::BusViewsByName GetBusesSortedByName() const;
+		// Perfect hashes the names are looked up by, precomputed by BuildIndexes
+		domain::PerfectHash::Layout GetStopNamesHash() const;
+		domain::PerfectHash::Layout GetBusNamesHash() const;
+		// In name order: names starting with the query when max_edits is 0, else names within
+		// max_edits character edits of it (of a prefix of them with as_prefix), see domain::NameIndex
+		std::vector<domain::StopId> SearchStops(std::string_view query, size_t max_edits, bool as_prefix) const;
+		std::vector<domain::BusId> SearchBuses(std::string_view query, size_t max_edits, bool as_prefix) const;
+		// Buses passing both stops in name order, by the stops' bitmaps; with `ordered` only those
+		// reaching `to` after `from` along their route
+		std::vector<domain::BusId> FindDirectBuses(domain::StopId from, domain::StopId to, bool ordered) const;
+		// The aggregates over stops and buses the options ask for; the travel time is the router's
+		domain::NetworkAnalytics ComputeAnalytics(const domain::AnalyticsOptions& options) const;
+		// Only the directions actually set, see GetActualDistance
+		const DistanceTable& GetDistances() const;
+
+		// Answered by the grid index over the stops, ordered by distance
+		std::vector<domain::NearbyStop> FindNearestStops(geo::Coordinates point, size_t count) const;
+		std::vector<domain::NearbyStop> FindStopsWithinRadius(geo::Coordinates point, double radius) const;
+		// Up to `count` nearest stops not further than `radius` metres
+		std::vector<domain::NearbyStop> FindNearestStopsWithinRadius(geo::Coordinates point, size_t count, double radius) const;
+		const geo::GridIndex& GetStopsIndex() const;
+
+		// Every internal container, see memory::Entry
+		memory::Report MemoryReport() const;
 
 	private:
-		std::deque<std::shared_ptr<domain::Stop>> stops_;
-		std::deque<std::shared_ptr<domain::Bus>> buses_;
+		domain::StopsTable stops_;
+		domain::BusesTable buses_{ {}, { 0u } };
+
+		domain::NameIndex stops_by_name_;
+		domain::NameIndex buses_by_name_;
 
-		std::unordered_map<std::string_view, domain::BusPointer, std::hash<std::string_view>> name_to_bus_;
-		std::unordered_map<std::string_view, domain::StopPointer, std::hash<std::string_view>> name_to_stop_;
+		DistanceTable distances_;
+		geo::DistanceMode length_mode_ = geo::DistanceMode::EXACT;
 
-		std::unordered_map<StopsPair, int, StopsPairHasher> stops_pair_to_distance_;
-		std::unordered_map<domain::StopPointer, std::unordered_set<domain::BusPointer>, std::hash<domain::StopPointer>> stop_to_passing_buses_;
+		geo::GridIndex stops_index_;    // ids are StopIds
+		StopBusBitmaps stop_buses_;
 
-		void AddToStopPassingBuses(const std::vector<domain::StopPointer>& stops, const std::string_view bus_name);
+		void AppendStopColumns(const domain::Stop& stop);
+		void AppendBusColumns(const domain::Bus& bus);
+		void BuildPassingBuses();
+		std::vector<domain::NearbyStop> ToNearbyStops(const std::vector<geo::GridIndex::Entry>& entries) const;
 	};
 }
@@ -1,5 +1,7 @@
+#include "parallel.h"
 #include "transport_router.h"
 
+
 namespace transport 
 {
 	using namespace std;
@@ -9,57 +11,81 @@ namespace transport
 
 	void Router::SetSettings(const double bus_wait_time, const double bus_velocity) 
 	{
-		settings_ = { bus_wait_time, bus_velocity };
+		settings_.wait_time = bus_wait_time;
+		settings_.velocity = bus_velocity;
 	}
 
-	const Router::Settings& Router::GetRouterSettings()
+	void Router::SetSettings(const Settings& settings) 
+	{
+		settings_ = settings;
+	}
+
+	const Router::Settings& Router::GetRouterSettings() const
 	{
 		return settings_;
 	}
 
-	void Router::AddWaitEdge(const string_view stop_name) 
+	void Router::AddWaitEdge(const StopId stop) 
 	{
 		EdgeInfo new_edge{
 			{
-				stop_to_vertex_id_[stop_name].start_wait,
-				stop_to_vertex_id_[stop_name].end_wait,
-				settings_.wait_time
+				GetWaitVertex(stop),
+				GetBoardVertex(stop),
+				{}
 			},
-			stop_name,
-			-1,
-			settings_.wait_time
+			EdgeType::WAIT,
+			stop_names_[stop],
+			{},
+			-1
 		};
+		new_edge.edge.weight = ComputeEdgeWeight(new_edge, settings_.wait_time, settings_.velocity);
 		edges_.push_back(move(new_edge));
 	}
 
 	void Router::AddBusEdge(const BusEdgeInfo& bus_edge_info) {
 		EdgeInfo new_edge{
 			{
-				stop_to_vertex_id_[bus_edge_info.stop_from].end_wait,
-				stop_to_vertex_id_[bus_edge_info.stop_to].start_wait,
-				bus_edge_info.dist / settings_.velocity * TO_MINUTES
+				GetBoardVertex(bus_edge_info.stop_from),
+				GetWaitVertex(bus_edge_info.stop_to),
+				{}
 			},
+			EdgeType::BUS,
 			bus_edge_info.bus_name,
+			{},
 			(int)bus_edge_info.span_count,
-			bus_edge_info.dist / settings_.velocity * TO_MINUTES
+			bus_edge_info.dist
+		};
+		new_edge.edge.weight = ComputeEdgeWeight(new_edge, settings_.wait_time, settings_.velocity);
+		edges_.push_back(move(new_edge));
+	}
+
+	void Router::AddWalkEdge(const StopId stop_from, const StopId stop_to, const double dist) 
+	{
+		EdgeInfo new_edge{
+			{
+				GetWaitVertex(stop_from),
+				GetWaitVertex(stop_to),
+				ComputeWalkTime(dist)
+			},
+			EdgeType::WALK,
+			stop_names_[stop_from],
+			stop_names_[stop_to],
+			-1,
+			dist
 		};
 		edges_.push_back(move(new_edge));
 	}
 
 	void Router::AddStop(const string_view stop_name) 
 	{
-		if (!stop_to_vertex_id_.count(stop_name)) 
-		{
-			size_t sz = stop_to_vertex_id_.size();
-			stop_to_vertex_id_[stop_name] = { sz * 2u, sz * 2u + 1u };
-		}
+		stop_names_.push_back(stop_name);
 	}
 
 	void Router::BuildGraph() 
 	{
 		if (!graph_) 
 		{
-			graph_ = move(Graph(stop_to_vertex_id_.size() * 2u));
+			graph_ = move(Graph(stop_names_.size() * 2u));
 		}
 		AddEdgesToGraph();
 	}
@@ -69,64 +95,260 @@ namespace transport
 		if (!router_ && graph_) 
 		{
 			router_.emplace(RouterG(*graph_));
+			dijkstra_.emplace(*graph_);
 		}
 	}
 
 	void Router::FillGraph(const TransportCatalogue& db)
 	{
-		for (const StopPointer stop : db.GetStopsInVector()) 
+		for (StopId stop = 0u; stop < db.GetStopCount(); ++stop) 
         {
-			std::string_view stop_name(*stop.get()->name.get());
-			AddStop(stop_name);
-			AddWaitEdge(stop_name);
+			AddStop(db.GetStop(stop).Name());
+			AddWaitEdge(stop);
 		}
 
-		for (const BusPointer bus : db.GetBusesInVector()) 
+		for (BusId bus_id = 0u; bus_id < db.GetBusCount(); ++bus_id) 
         {
-			const std::string_view bus_name = *bus->name;
-			for (size_t i = 0u; i < bus->route.size() - 1u; ++i) {
-				const std::string_view stop_name_from = *bus->route[i]->name;
+			const BusView bus = db.GetBus(bus_id);
+			const std::string_view bus_name = bus.Name();
+			const auto route = bus.Route();
+			for (size_t i = 0u; i + 1u < route.size(); ++i) {
+				const StopId stop_from = route.begin()[i];
 
 				double prev_actual = 0.0;
-				std::string_view prev_stop_name = stop_name_from;
+				StopId prev_stop = stop_from;
 
-				for (size_t j = i + 1u; j < bus->route.size(); ++j) 
+				for (size_t j = i + 1u; j < route.size(); ++j) 
                 {
-					const std::string_view stop_name_to = *bus->route[j]->name;
-					optional<double> actual = db.GetActualDistanceBetweenStops(prev_stop_name, stop_name_to);
+					const StopId stop_to = route.begin()[j];
+					optional<double> actual = db.GetActualDistance(prev_stop, stop_to);
 					if (actual)
 					{
 						AddBusEdge({
-							stop_name_from,
-							stop_name_to,
+							stop_from,
+							stop_to,
 							bus_name,
 							j - i,
 							prev_actual + actual.value()
 						});
-						prev_stop_name = stop_name_to;
+						prev_stop = stop_to;
 						prev_actual += actual.value();
 					}
 				}
 			}
 		}
+
+		AddWalkEdges(db);
 	}
 
-	optional<RouteInfo> Router::GetRouteInfo(const string_view from, const string_view to) const {
-		const auto route = router_->BuildRoute(
-			stop_to_vertex_id_.at(from).start_wait,
-			stop_to_vertex_id_.at(to).start_wait
-		);
-		if (!route) 
+	bool Router::GetRouteInfo(const StopId from, const StopId to, 
+		const vector<StopId>& via, const RouteOptions& options, RouteInfo& result, RouteSearchStats* stats) const 
+	{
+		optional<RoutingMetric> metric_storage;
+		const RoutingMetric* metric = ResolveMetric(options, metric_storage);
+		graph::SearchBudget budget = MakeBudget(options);
+		QueryBuffers& buffers = GetQueryBuffers();
+
+		result.items.clear();
+		Weight total_weight{};
+		StopId leg_from = from;
+		size_t exceeded_leg = 0u;
+		for (size_t i = 0u; i <= via.size(); ++i) 
 		{
-			return nullopt;
+			const StopId leg_to = (i < via.size()) ? via[i] : to;
+			if (!IsKnownStop(leg_from) || !IsKnownStop(leg_to)) 
+			{
+				FinishQuery(budget, stats, exceeded_leg);
+				return false;
+			}
+			buffers.sources.assign(1u, { GetWaitVertex(leg_from), Weight{} });
+			buffers.targets.assign(1u, { GetWaitVertex(leg_to), Weight{} });
+			const bool exceeded_before = budget.exceeded;
+			const bool found = FindPath(buffers.sources, buffers.targets, metric, budget, buffers.path);
+			if (budget.exceeded && !exceeded_before) 
+			{
+				exceeded_leg = i;
+			}
+			if (!found) 
+			{
+				FinishQuery(budget, stats, exceeded_leg);
+				return false;
+			}
+
+			total_weight += buffers.path.weight;
+			MakeItemsByEdgeIds(buffers.path.edges, metric, result.items);
+			leg_from = leg_to;
 		}
+		result.total_time = WeightTraits::ToMinutes(total_weight);
+		FinishQuery(budget, stats, exceeded_leg);
 
-		return RouteInfo{
-			route->weight,
-			MakeItemsByEdgeIds(route->edges)
+		return true;
+	}
+
+	bool Router::GetRouteInfo(const vector<SnappedStop>& from, const vector<SnappedStop>& to, 
+		const RouteOptions& options, RouteInfo& result, RouteSearchStats* stats) const 
+	{
+		optional<RoutingMetric> metric_storage;
+		const RoutingMetric* metric = ResolveMetric(options, metric_storage);
+		graph::SearchBudget budget = MakeBudget(options);
+		QueryBuffers& buffers = GetQueryBuffers();
+
+		buffers.sources.clear();
+		for (const auto& snapped : from) 
+		{
+			if (!IsKnownStop(snapped.stop)) 
+			{
+				FinishQuery(budget, stats);
+				return false;
+			}
+			buffers.sources.push_back({ GetWaitVertex(snapped.stop), ComputeWalkTime(snapped.distance) });
+		}
+		buffers.targets.clear();
+		for (const auto& snapped : to) 
+		{
+			if (!IsKnownStop(snapped.stop)) 
+			{
+				FinishQuery(budget, stats);
+				return false;
+			}
+			buffers.targets.push_back({ GetWaitVertex(snapped.stop), ComputeWalkTime(snapped.distance) });
+		}
+
+		const bool found = FindPath(buffers.sources, buffers.targets, metric, budget, buffers.path);
+		FinishQuery(budget, stats);
+		if (!found) 
+		{
+			return false;
+		}
+
+		const Path& path = buffers.path;
+		result.total_time = WeightTraits::ToMinutes(path.weight);
+		result.items.clear();
+
+		const SnappedStop& source = from[path.source_index];
+		if (source.distance > 0.0) 
+		{
+			result.items.push_back({ EdgeType::WALK, {}, source.stop_name, 0, 
+				WeightTraits::ToMinutes(buffers.sources[path.source_index].offset) });
+		}
+		MakeItemsByEdgeIds(path.edges, metric, result.items);
+
+		const SnappedStop& target = to[path.target_index];
+		if (target.distance > 0.0) 
+		{
+			result.items.push_back({ EdgeType::WALK, target.stop_name, {}, 0, 
+				WeightTraits::ToMinutes(buffers.targets[path.target_index].offset) });
+		}
+
+		return true;
+	}
+
+	RoutingMetric Router::Customize(const double bus_wait_time, const double bus_velocity) const 
+	{
+		if (bus_wait_time < 0.0 || bus_velocity <= 0.0) 
+		{
+			throw domain_error("Bus wait time should be non-negative and velocity positive");
+		}
+
+		RoutingMetric metric{ bus_wait_time, bus_velocity, {} };
+		metric.weights.reserve(edges_.size());
+		for (const EdgeInfo& edge_info : edges_) 
+		{
+			metric.weights.push_back(ComputeEdgeWeight(edge_info, bus_wait_time, bus_velocity));
+		}
+		return metric;
+	}
+
+	std::optional<Distribution> Router::ComputeTravelTimes() const 
+	{
+		if (!router_) { return std::nullopt; }
+
+		// Each row is as long as any other, so threads take even chunks of rows
+		static const size_t min_rows_per_thread = 64u;
+		const size_t stops_count = stop_names_.size();
+		const size_t threads_count = parallel::ThreadsFor(stops_count, min_rows_per_thread);
+		std::vector<std::vector<double>> times(threads_count);
+		parallel::Run(threads_count, [&](size_t thread) 
+		{
+			std::vector<double>& thread_times = times[thread];
+			for (StopId from = static_cast<StopId>(stops_count * thread / threads_count); 
+				from < stops_count * (thread + 1u) / threads_count; ++from) 
+			{
+				for (StopId to = 0u; to < stops_count; ++to) 
+				{
+					if (to == from) { continue; }
+					if (const auto weight = router_->GetRouteWeight(GetWaitVertex(from), GetWaitVertex(to))) 
+					{
+						thread_times.push_back(WeightTraits::ToMinutes(*weight));
+					}
+				}
+			}
+		});
+
+		for (size_t thread = 1u; thread < threads_count; ++thread) 
+		{
+			times.front().insert(times.front().end(), times[thread].begin(), times[thread].end());
+			std::vector<double>().swap(times[thread]);
+		}
+		return MakeDistribution(times.front());
+	}
+
+	RouterMetrics Router::GetMetrics() const 
+	{
+		return {
+			metrics_.route_requests.load(memory_order_relaxed),
+			metrics_.searches.load(memory_order_relaxed),
+			metrics_.settled_vertices.load(memory_order_relaxed),
+			metrics_.budget_exceeded.load(memory_order_relaxed)
 		};
 	}
 
+	memory::Report Router::MemoryReport() const 
+	{
+		memory::Report report = {
+			memory::Of("stop_names", stop_names_),
+			memory::Of("edges", edges_)
+		};
+		if (graph_) 
+		{
+			memory::Append(report, "graph", graph_->MemoryReport());
+		}
+		if (router_) 
+		{
+			memory::Append(report, "routes", router_->MemoryReport());
+		}
+		if (session_metric_) 
+		{
+			report.push_back(memory::Of("session_metric.weights", session_metric_->weights));
+		}
+		return report;
+	}
+
+	void Router::SetSessionMetric(const double bus_wait_time, const double bus_velocity) 
+	{
+		if (bus_wait_time == settings_.wait_time && bus_velocity == settings_.velocity) 
+		{
+			session_metric_.reset();
+			return;
+		}
+		session_metric_ = Customize(bus_wait_time, bus_velocity);
+	}
+
+	graph::VertexId Router::GetWaitVertex(const StopId stop) 
+	{
+		return static_cast<graph::VertexId>(stop) * 2u;
+	}
+
+	graph::VertexId Router::GetBoardVertex(const StopId stop) 
+	{
+		return static_cast<graph::VertexId>(stop) * 2u + 1u;
+	}
+
+	bool Router::IsKnownStop(const StopId stop) const 
+	{
+		return stop < stop_names_.size();
+	}
+
 	void Router::AddEdgesToGraph() 
 	{
 		for (auto& edge_info : edges_) 
@@ -135,32 +357,126 @@ namespace transport
 		}
 	}
 
-	vector<RouteItem> Router::MakeItemsByEdgeIds(const vector<graph::EdgeId>& edge_ids) const 
+	void Router::AddWalkEdges(const TransportCatalogue& db) 
 	{
-		vector<RouteItem> result;
-		result.reserve(edge_ids.size());
+		if (settings_.walk_transfer_radius <= 0.0 || settings_.walk_transfer_max_neighbours == 0u) 
+		{
+			return;
+		}
 
-		for (const auto id : edge_ids) 
+		// The grid index keeps this near-linear in the number of stops instead of comparing all pairs
+		for (StopId stop = 0u; stop < db.GetStopCount(); ++stop) 
 		{
-			const EdgeInfo& edge_info = edges_[id];
-			RouteItem tmp;
-			if (edge_info.span_count == -1) 
-			{
-				tmp.wait_item = {
-					edge_info.name,
-					edge_info.time
-				};
-			}
-			else 
+			size_t neighbours = 0u;
+			for (const auto& nearby : db.FindStopsWithinRadius(db.GetStop(stop).Coords(), settings_.walk_transfer_radius)) 
 			{
-				tmp.bus_item = {
-					edge_info.name,
-					edge_info.span_count,
-					edge_info.time
-				};
+				if (nearby.stop == stop) 
+				{
+					continue;
+				}
+				if (neighbours++ == settings_.walk_transfer_max_neighbours) 
+				{
+					break;
+				}
+				AddWalkEdge(stop, nearby.stop, nearby.distance);
 			}
-			result.push_back(move(tmp));
 		}
-		return result;
+	}
+
+	void Router::MakeItemsByEdgeIds(const vector<graph::EdgeId>& edge_ids, const RoutingMetric* metric, 
+		vector<RouteItem>& items) const 
+	{
+		for (const auto id : edge_ids) 
+		{
+			const EdgeInfo& edge_info = edges_[id];
+			items.push_back({
+				edge_info.type,
+				edge_info.name,
+				edge_info.walk_to,
+				edge_info.span_count,
+				WeightTraits::ToMinutes(metric ? metric->weights[id] : edge_info.edge.weight)
+			});
+		}
+	}
+
+	Weight Router::ComputeWalkTime(const double distance) const 
+	{
+		return WeightTraits::FromMinutes(distance / settings_.pedestrian_velocity * TO_MINUTES);
+	}
+
+	Weight Router::ComputeEdgeWeight(const EdgeInfo& edge_info, const double bus_wait_time, const double bus_velocity) const 
+	{
+		switch (edge_info.type) 
+		{
+		case EdgeType::WAIT:
+			return WeightTraits::FromMinutes(bus_wait_time);
+		case EdgeType::BUS:
+			return WeightTraits::FromMinutes(edge_info.dist / bus_velocity * TO_MINUTES);
+		case EdgeType::WALK:
+			return ComputeWalkTime(edge_info.dist);
+		}
+		return Weight{};
+	}
+
+	const RoutingMetric* Router::ResolveMetric(const RouteOptions& options, optional<RoutingMetric>& storage) const 
+	{
+		const double wait_time = options.bus_wait_time.value_or(session_metric_ ? session_metric_->wait_time : settings_.wait_time);
+		const double velocity = options.bus_velocity.value_or(session_metric_ ? session_metric_->velocity : settings_.velocity);
+
+		if (session_metric_ && session_metric_->wait_time == wait_time && session_metric_->velocity == velocity) 
+		{
+			return &*session_metric_;
+		}
+		if (wait_time == settings_.wait_time && velocity == settings_.velocity) 
+		{
+			return nullptr;
+		}
+		storage = Customize(wait_time, velocity);
+		return &*storage;
+	}
+
+	bool Router::FindPath(const vector<Endpoint>& sources, const vector<Endpoint>& targets, 
+		const RoutingMetric* metric, graph::SearchBudget& budget, Path& path) const 
+	{
+		if (metric == nullptr) 
+		{
+			return router_->BuildRoute(sources, targets, path);
+		}
+
+		metrics_.searches.fetch_add(1u, memory_order_relaxed);
+		return dijkstra_->BuildRoute(sources, targets, metric->weights, path, &budget);
+	}
+
+	Router::QueryBuffers& Router::GetQueryBuffers() 
+	{
+		thread_local QueryBuffers buffers;
+		return buffers;
+	}
+
+	graph::SearchBudget Router::MakeBudget(const RouteOptions& options) const 
+	{
+		graph::SearchBudget budget;
+		budget.max_settled_vertices = options.max_settled_vertices;
+		if (options.time_budget) 
+		{
+			budget.deadline = graph::SearchBudget::Clock::now() + *options.time_budget;
+		}
+		return budget;
+	}
+
+	void Router::FinishQuery(const graph::SearchBudget& budget, RouteSearchStats* stats, size_t exceeded_leg) const 
+	{
+		metrics_.route_requests.fetch_add(1u, memory_order_relaxed);
+		metrics_.settled_vertices.fetch_add(budget.settled_vertices, memory_order_relaxed);
+		if (budget.exceeded) 
+		{
+			metrics_.budget_exceeded.fetch_add(1u, memory_order_relaxed);
+		}
+		if (stats) 
+		{
+			stats->settled_vertices = budget.settled_vertices;
+			stats->budget_exceeded = budget.exceeded;
+			stats->exceeded_leg = exceeded_leg;
+		}
 	}
 }
@@ -1,6 +1,8 @@
 #pragma once
 
+#include "graph.h"
 #include "router.h"
+#include "dijkstra.h"
 #include "transport_catalogue.h"
 
 #include <utility>
@@ -10,43 +12,103 @@
 #include <string_view>
 #include <optional>
 #include <functional>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
 
 namespace transport 
 {
+#ifdef TRANSPORT_INTEGER_WEIGHTS
+	using Weight = int32_t;     // centiseconds
+#else
+	using Weight = double;      // minutes
+#endif
+	using WeightTraits = graph::WeightTraits<Weight>;
+
+	enum class EdgeType 
+    {
+		WAIT,
+		BUS,
+		WALK
+	};
+
 	struct EdgeInfo 
     {
-		graph::Edge<double> edge;
+		graph::Edge<Weight> edge;
+		EdgeType type = EdgeType::WAIT;
 
-		std::string_view name;
+		std::string_view name;      // stop to wait at, bus name or stop to walk from
+		std::string_view walk_to;
 		int span_count = -1;
-		double time = 0.0;
+		double dist = 0.0;          // metres, metric-independent input of bus and walk weights
 	};
 
-	struct RouteItemWait 
+	// One step of a route answer, plain data so that answers can be written into reused buffers.
+	// WALK items may leave the coordinate side of a walk empty
+	struct RouteItem 
     {
-		std::string_view stop_name;
+		EdgeType type = EdgeType::WAIT;
+		std::string_view name;      // stop to wait at, bus name or stop walked from
+		std::string_view walk_to;
+		int span_count = 0;
 		double time = 0.0;
 	};
 
-	struct RouteItemBus 
+	// Per-request overrides of the routing settings; empty fields keep the session values
+	struct RouteOptions 
     {
-		std::string_view bus_name;
-		int span_count = -1;        // CHECK THIS OUT
-		double time = 0.0;
+		std::optional<double> bus_wait_time;
+		std::optional<double> bus_velocity;
+
+		// Search limits; lookups in the precomputed routes table are never limited
+		std::optional<size_t> max_settled_vertices;
+		std::optional<std::chrono::steady_clock::duration> time_budget;
 	};
 
-	struct RouteItem 
+	// Filled by a route query: the answer is the best one found so far if the budget was exceeded
+	struct RouteSearchStats 
+    {
+		size_t settled_vertices = 0u;
+		bool budget_exceeded = false;
+		// The leg searched when the budget ran out, 0 being the one to the first via point.
+		// One budget covers all legs, so every leg after it fails without a search
+		size_t exceeded_leg = 0u;
+	};
+
+	struct RouterMetrics 
     {
-		std::optional<RouteItemWait> wait_item;
-		std::optional<RouteItemBus> bus_item;
+		uint64_t route_requests = 0u;
+		uint64_t searches = 0u;
+		uint64_t settled_vertices = 0u;
+		uint64_t budget_exceeded = 0u;
 	};
 
+	// Edge weights customized for a wait time / velocity other than the base ones
+	struct RoutingMetric 
+    {
+		double wait_time = 0.0;
+		double velocity = 0.0;
+		std::vector<Weight> weights;    // indexed by EdgeId
+	};
+
+	// Candidate stop for a route endpoint with the walking distance to it (metres)
+	struct SnappedStop 
+    {
+		domain::StopId stop = domain::NO_STOP;
+		std::string_view stop_name;
+		double distance = 0.0;
+	};
+
+	// Queries overwrite it in place; a caller keeping one per thread reuses the items storage
 	struct RouteInfo 
     {
 		double total_time = 0.0;
 		std::vector<RouteItem> items;
 	};
 
+	// Once BuildRouter has run, the const queries may be issued from several threads at once:
+	// their scratch memory is per-thread and the metrics are atomic. Setters, the build steps
+	// and SetSessionMetric are writers and must not overlap with queries
 	class Router 
     {
 	public:
@@ -54,24 +116,34 @@ namespace transport
         {
 			double wait_time = 6.0;
 			double velocity = 40.0;
+			double pedestrian_velocity = 5.0;
+			size_t snap_stops_count = 3u;
+			double walk_transfer_radius = 0.0;      // metres, 0 disables walking transfers
+			size_t walk_transfer_max_neighbours = 5u;
 		};
 
 	private:
 		static constexpr double TO_MINUTES = (3.6 / 60.0);
 
-		using Graph = graph::DirectedWeightedGraph<double>;
-		using RouterG = graph::TransportRouter<double>;
+		using Graph = graph::DirectedWeightedGraph<Weight>;
+		using RouterG = graph::TransportRouter<Weight>;
+		using DijkstraG = graph::DijkstraRouter<Weight>;
+		using Endpoint = graph::RouteEndpoint<Weight>;
 
-		struct Vertexes 
+		using Path = graph::RoutePath<Weight>;
+
+		// Scratch storage of the route queries running on one thread
+		struct QueryBuffers 
         {
-			size_t start_wait;
-			size_t end_wait;
+			std::vector<Endpoint> sources;
+			std::vector<Endpoint> targets;
+			Path path;
 		};
 
 		struct BusEdgeInfo
 		{
-			std::string_view stop_from; 
-			std::string_view stop_to;
+			domain::StopId stop_from; 
+			domain::StopId stop_to;
 			std::string_view bus_name; 
 			size_t span_count;
 			double dist;
@@ -82,28 +154,79 @@ namespace transport
 		explicit Router(const size_t graph_size);
 
 		void SetSettings(const double bus_wait_time, const double bus_velocity);
-		const Settings& GetRouterSettings();
-		void AddWaitEdge(const std::string_view stop_name);
-		void AddBusEdge(const BusEdgeInfo& bus_edge_info);
+		void SetSettings(const Settings& settings);
+		const Settings& GetRouterSettings() const;
+		// Stops are added in StopId order: stop i waits at vertex 2i and boards at vertex 2i + 1
 		void AddStop(const std::string_view stop_name);
+		void AddWaitEdge(const domain::StopId stop);
+		void AddBusEdge(const BusEdgeInfo& bus_edge_info);
+		void AddWalkEdge(const domain::StopId stop_from, const domain::StopId stop_to, const double dist);
 
 		void BuildGraph();
 		void BuildRouter();
 
 		void FillGraph(const TransportCatalogue& db);
 
-		std::optional<RouteInfo> GetRouteInfo(const std::string_view from, const std::string_view to) const;
+		// Route from -> via[0] -> ... -> via[n-1] -> to, legs concatenated into one answer.
+		// Returns false if there is no route or a stop is unknown. With the base metric no heap allocation
+		// happens once `result` and the per-thread buffers have grown large enough
+		bool GetRouteInfo(const domain::StopId from, const domain::StopId to, 
+			const std::vector<domain::StopId>& via, const RouteOptions& options, 
+			RouteInfo& result, RouteSearchStats* stats = nullptr) const;
+		// Best route between any pair of candidate stops, walking time to them included
+		bool GetRouteInfo(const std::vector<SnappedStop>& from, const std::vector<SnappedStop>& to, 
+			const RouteOptions& options, RouteInfo& result, RouteSearchStats* stats = nullptr) const;
+
+		RouterMetrics GetMetrics() const;
+		// Minutes of the best route between every ordered pair of distinct stops that has one,
+		// read from the routes table by rows spread over the hardware threads. None without the table
+		std::optional<domain::Distribution> ComputeTravelTimes() const;
+		// Containers of the graph and the routes table are there once built
+		memory::Report MemoryReport() const;
+
+		// Customization phase: recomputes edge weights for another wait time / velocity
+		// over the unchanged graph, O(edges) instead of rebuilding the routes table
+		RoutingMetric Customize(const double bus_wait_time, const double bus_velocity) const;
+		// Metric used by every request of the session that does not override it
+		void SetSessionMetric(const double bus_wait_time, const double bus_velocity);
 
 	private:
 		Settings settings_;
 
 		std::optional<Graph> graph_ = std::nullopt;
 		std::optional<RouterG> router_ = std::nullopt;
+		std::optional<DijkstraG> dijkstra_ = std::nullopt;
+		std::optional<RoutingMetric> session_metric_ = std::nullopt;
+
+		struct AtomicMetrics 
+        {
+			std::atomic<uint64_t> route_requests{ 0u };
+			std::atomic<uint64_t> searches{ 0u };
+			std::atomic<uint64_t> settled_vertices{ 0u };
+			std::atomic<uint64_t> budget_exceeded{ 0u };
+		};
+		mutable AtomicMetrics metrics_;
 
-		std::unordered_map<std::string_view, Vertexes, std::hash<std::string_view>> stop_to_vertex_id_;
+		std::vector<std::string_view> stop_names_;     // indexed by StopId
 		std::vector<EdgeInfo> edges_;
 
+		static graph::VertexId GetWaitVertex(const domain::StopId stop);
+		static graph::VertexId GetBoardVertex(const domain::StopId stop);
+		bool IsKnownStop(const domain::StopId stop) const;
 		void AddEdgesToGraph();
-		std::vector<RouteItem> MakeItemsByEdgeIds(const std::vector<graph::EdgeId>& edge_ids) const;
+		void AddWalkEdges(const TransportCatalogue& db);
+		// Appends the items of the edges to `items`
+		void MakeItemsByEdgeIds(const std::vector<graph::EdgeId>& edge_ids, const RoutingMetric* metric, 
+			std::vector<RouteItem>& items) const;
+		Weight ComputeWalkTime(const double distance) const;
+		Weight ComputeEdgeWeight(const EdgeInfo& edge_info, const double bus_wait_time, const double bus_velocity) const;
+
+		// nullptr stands for the base metric, answered from the routes table
+		const RoutingMetric* ResolveMetric(const RouteOptions& options, std::optional<RoutingMetric>& storage) const;
+		bool FindPath(const std::vector<Endpoint>& sources, const std::vector<Endpoint>& targets, 
+			const RoutingMetric* metric, graph::SearchBudget& budget, Path& path) const;
+		static QueryBuffers& GetQueryBuffers();
+		graph::SearchBudget MakeBudget(const RouteOptions& options) const;
+		void FinishQuery(const graph::SearchBudget& budget, RouteSearchStats* stats, size_t exceeded_leg = 0u) const;
 	};
 }
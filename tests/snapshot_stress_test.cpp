@@ -0,0 +1,207 @@
+#include "test_helpers.h"
+
+#include <algorithm>
+#include <atomic>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace std::literals;
+
+namespace
+{
+	// A route query with the answer the first version gave, which every later one must repeat
+	struct RouteQuery
+	{
+		std::string_view from;
+		std::string_view to;
+		std::vector<std::string_view> via;
+		transport::RouteOptions options;
+		std::optional<double> total_time;
+	};
+
+	// Readers query whatever version is published while a writer keeps publishing new ones:
+	// copies of the current data, and data with a stop replaced by itself through a delta.
+	// Every version answers alike, so each answer is checked against the first version's.
+	// Meant to run under ThreadSanitizer, which reports any access the versions do not guard
+	void TestReadersDuringUpdates()
+	{
+		const json::Array network = tests::MakeNetwork(80u, 40u, 8u);
+		const tests::TempFile file("snapshot_stress.db"s);
+		tests::MakeBase(tests::MakeBaseInput(network, file.Path()));
+		tests::LoadedBase loaded(file.Path());
+		request_handler::RequestHandler& rh = loaded.rh;
+		const std::shared_ptr<const transport::Snapshot> first = loaded.snapshot;
+
+		std::vector<std::string> stops;
+		for (const domain::StopView stop : rh.GetStops(*first))
+		{
+			stops.emplace_back(stop.Name());
+		}
+		std::vector<std::string> buses;
+		for (const domain::BusView bus : rh.GetBuses(*first))
+		{
+			buses.emplace_back(bus.Name());
+		}
+
+		// Table lookups on the base metric, searches on another one, via points on both
+		std::vector<RouteQuery> queries;
+		transport::RouteOptions searched;
+		searched.bus_velocity = 35.0;
+		for (size_t i = 0u; i < stops.size(); ++i)
+		{
+			RouteQuery query{ stops[i], stops[(i * 7u + 3u) % stops.size()], {}, (i % 2u == 0u) ? transport::RouteOptions{} : searched, {} };
+			if (i % 3u == 0u)
+			{
+				query.via.push_back(stops[(i + 5u) % stops.size()]);
+			}
+			transport::RouteInfo route;
+			if (rh.GetRouteInfo(*first, query.from, query.to, query.via, query.options, route))
+			{
+				query.total_time = route.total_time;
+			}
+			queries.push_back(std::move(query));
+		}
+
+		std::atomic<bool> done{ false };
+		std::atomic<size_t> mismatches{ 0u };
+		std::atomic<size_t> answered{ 0u };
+		const auto reader = [&](size_t thread)
+		{
+			transport::RouteInfo route;
+			for (size_t round = thread; !done.load() || round < thread + 2u; ++round)
+			{
+				const std::shared_ptr<const transport::Snapshot> snapshot = rh.AcquireSnapshot();
+				const std::string& stop = stops[round % stops.size()];
+				const std::string& bus = buses[round % buses.size()];
+
+				const auto stop_info = rh.GetStopInfo(*snapshot, stop);
+				const auto bus_info = rh.GetBusInfo(*snapshot, bus);
+				const auto expected_bus = rh.GetBusInfo(*first, bus);
+				if (!stop_info || stop_info->passing_buses.size() != rh.GetStopInfo(*first, stop)->passing_buses.size()
+					|| !bus_info || bus_info->routh_actual_length != expected_bus->routh_actual_length
+					|| bus_info->curvature != expected_bus->curvature)
+				{
+					++mismatches;
+				}
+
+				const RouteQuery& query = queries[round % queries.size()];
+				const bool found = rh.GetRouteInfo(*snapshot, query.from, query.to, query.via, query.options, route);
+				if (found != query.total_time.has_value() || (found && route.total_time != *query.total_time))
+				{
+					++mismatches;
+				}
+
+				const auto direct = rh.FindDirectBuses(*snapshot, query.from, query.to, round % 2u == 0u);
+				if (!direct || *direct != *rh.FindDirectBuses(*first, query.from, query.to, round % 2u == 0u))
+				{
+					++mismatches;
+				}
+				++answered;
+			}
+		};
+
+		const size_t readers = 4u;
+		std::vector<std::thread> threads;
+		for (size_t thread = 0u; thread < readers; ++thread)
+		{
+			threads.emplace_back(reader, thread);
+		}
+		for (size_t update = 0u; update < 12u; ++update)
+		{
+			if (update % 2u == 0u)
+			{
+				rh.BeginUpdate();
+			}
+			else
+			{
+				// The stop given again as it is, with its road distances
+				const std::shared_ptr<const transport::Snapshot> current = rh.AcquireSnapshot();
+				const domain::StopView stop = current->catalogue.GetStop(static_cast<domain::StopId>(update % stops.size()));
+				domain::BaseDelta delta;
+				delta.stops.emplace_back(std::string(stop.Name()), stop.Coords().lat, stop.Coords().lng);
+				current->catalogue.GetDistances().ForEach([&](domain::StopId from, domain::StopId to, int distance)
+				{
+					if (from == stop.Id())
+					{
+						delta.road_distances.push_back({ std::string(stop.Name()), std::string(current->catalogue.GetStop(to).Name()), distance });
+					}
+				});
+				rh.BeginUpdate(delta);
+			}
+			rh.BuildCatalogueIndexes();
+			rh.FillRouter();
+			rh.PublishDraft();
+		}
+		done = true;
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+
+		CHECK(rh.AcquireSnapshot() != first);
+		CHECK(answered.load() >= readers * 2u);
+		CHECK(mismatches.load() == 0u);
+	}
+
+	// Readers acquire as fast as they can while a writer keeps replacing empty versions, so
+	// that a replaced version is often freed while a reader is taking it. Every acquired
+	// version must be one of those published, and the newest a reader saw never goes back
+	void TestAcquireDuringPublishes()
+	{
+		transport::SnapshotHolder holder;
+		const size_t versions = 5000u;
+		std::vector<std::shared_ptr<const transport::Snapshot>> published;
+		for (size_t i = 0u; i < versions; ++i)
+		{
+			published.push_back(std::make_shared<const transport::Snapshot>());
+		}
+		holder.Publish(published.front());
+
+		std::atomic<bool> done{ false };
+		std::atomic<size_t> mismatches{ 0u };
+		const auto reader = [&]()
+		{
+			size_t newest = 0u;
+			while (!done.load())
+			{
+				const std::shared_ptr<const transport::Snapshot> snapshot = holder.Acquire();
+				const auto it = std::find(published.begin() + newest, published.end(), snapshot);
+				if (it == published.end())
+				{
+					++mismatches;
+					continue;
+				}
+				newest = static_cast<size_t>(it - published.begin());
+			}
+		};
+
+		std::vector<std::thread> threads;
+		for (size_t thread = 0u; thread < 4u; ++thread)
+		{
+			threads.emplace_back(reader);
+		}
+		for (size_t i = 1u; i < versions; ++i)
+		{
+			holder.Publish(published[i]);
+		}
+		done = true;
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+
+		CHECK(holder.Acquire() == published.back());
+		CHECK(mismatches.load() == 0u);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	return tests::RunCases({
+		{ "readers_during_updates"s, TestReadersDuringUpdates },
+		{ "acquire_during_publishes"s, TestAcquireDuringPublishes }
+	}, argc, argv);
+}
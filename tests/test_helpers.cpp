@@ -0,0 +1,223 @@
+#include "test_helpers.h"
+
+#include "geo.h"
+#include "json_reader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+
+namespace tests
+{
+	using namespace std::literals;
+
+	TempFile::TempFile(const std::string& name)
+		: path_((std::filesystem::temp_directory_path() / ("transport_tests_"s + name)).string())
+	{
+	}
+
+	TempFile::~TempFile()
+	{
+		std::error_code ignored;
+		std::filesystem::remove(path_, ignored);
+	}
+
+	const std::string& TempFile::Path() const
+	{
+		return path_;
+	}
+
+	json::Array MakeNetwork(size_t stop_count, size_t bus_count, unsigned seed)
+	{
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+		std::vector<std::string> stop_names;
+		std::vector<geo::Coordinates> coords;
+		for (size_t i = 0u; i < stop_count; ++i)
+		{
+			stop_names.push_back((i % 5u == 0u ? "Остановка "s : "Stop "s) + std::to_string(i));
+			coords.push_back({ 55.55 + 0.1 * unit(random), 37.5 + 0.15 * unit(random) });
+		}
+
+		json::Array buses;
+		std::map<std::pair<size_t, size_t>, int> distances;
+		std::uniform_int_distribution<size_t> any_stop(0u, stop_count - 1u);
+		std::uniform_int_distribution<size_t> route_size(2u, 10u);
+		for (size_t i = 0u; i < bus_count; ++i)
+		{
+			const bool roundtrip = (i % 2u == 0u);
+			std::vector<size_t> route(route_size(random));
+			std::generate(route.begin(), route.end(), [&]() { return any_stop(random); });
+			if (roundtrip)
+			{
+				route.push_back(route.front());
+			}
+			for (size_t j = 0u; j + 1u < route.size(); ++j)
+			{
+				const size_t from = route[j];
+				const size_t to = route[j + 1u];
+				if (from == to || distances.count({ from, to }) || distances.count({ to, from })) { continue; }
+
+				const double straight = geo::ComputeDistance(coords[from], coords[to]);
+				const auto road = [&]() { return static_cast<int>(std::lround(straight * (1.1 + 0.5 * unit(random)))) + 1; };
+				const bool forward = unit(random) < 0.5;
+				distances[forward ? std::make_pair(from, to) : std::make_pair(to, from)] = road();
+				if (unit(random) < 0.3)
+				{
+					distances[forward ? std::make_pair(to, from) : std::make_pair(from, to)] = road();
+				}
+			}
+
+			json::Array stops;
+			for (const size_t stop : route)
+			{
+				stops.push_back(json::Node(stop_names[stop]));
+			}
+			buses.push_back(json::Dict{
+				{ "type"s,         json::Node("Bus"s)                                                 },
+				{ "name"s,         json::Node(std::to_string(i) + (i % 3u == 0u ? "к"s : ""s)) },
+				{ "stops"s,        json::Node(std::move(stops))                                       },
+				{ "is_roundtrip"s, json::Node(roundtrip)                                              }
+			});
+		}
+
+		json::Array requests;
+		for (size_t i = 0u; i < stop_count; ++i)
+		{
+			json::Dict road_distances;
+			for (auto it = distances.lower_bound({ i, 0u }); it != distances.end() && it->first.first == i; ++it)
+			{
+				road_distances[stop_names[it->first.second]] = json::Node(it->second);
+			}
+			requests.push_back(json::Dict{
+				{ "type"s,           json::Node("Stop"s)                  },
+				{ "name"s,           json::Node(stop_names[i])            },
+				{ "latitude"s,       json::Node(coords[i].lat)            },
+				{ "longitude"s,      json::Node(coords[i].lng)            },
+				{ "road_distances"s, json::Node(std::move(road_distances)) }
+			});
+		}
+		for (json::Node& bus : buses)
+		{
+			requests.push_back(std::move(bus));
+		}
+		return requests;
+	}
+
+	json::Dict MakeBaseInput(json::Array base_requests, const std::string& file, std::optional<bool> approximate_length)
+	{
+		json::Dict input = {
+			{ "serialization_settings"s, json::Node(json::Dict{ { "file"s, json::Node(file) } }) },
+			{ "routing_settings"s, json::Node(json::Dict{
+				{ "bus_wait_time"s, json::Node(4) },
+				{ "bus_velocity"s,  json::Node(30) }
+			}) },
+			{ "render_settings"s, json::Node(json::Dict{
+				{ "width"s,                 json::Node(1000.0) },
+				{ "height"s,                json::Node(800.0) },
+				{ "padding"s,               json::Node(40.0) },
+				{ "stop_radius"s,           json::Node(4.0) },
+				{ "line_width"s,            json::Node(10.0) },
+				{ "bus_label_font_size"s,   json::Node(16) },
+				{ "bus_label_offset"s,      json::Node(json::Array{ json::Node(7.0), json::Node(15.0) }) },
+				{ "stop_label_font_size"s,  json::Node(14) },
+				{ "stop_label_offset"s,     json::Node(json::Array{ json::Node(7.0), json::Node(-3.0) }) },
+				{ "underlayer_color"s,      json::Node("white"s) },
+				{ "underlayer_width"s,      json::Node(3.0) },
+				{ "color_palette"s,         json::Node(json::Array{ json::Node("green"s), json::Node("red"s) }) }
+			}) },
+			{ "base_requests"s, json::Node(std::move(base_requests)) }
+		};
+		if (approximate_length)
+		{
+			input["stat_settings"s] = json::Node(json::Dict{ { "approximate_geographic_length"s, json::Node(*approximate_length) } });
+		}
+		return input;
+	}
+
+	namespace
+	{
+		std::stringstream ToStream(const json::Node& node)
+		{
+			std::stringstream stream;
+			json::Print(json::Document(node), stream);
+			return stream;
+		}
+	}
+
+	void MakeBase(const json::Dict& input)
+	{
+		renderer::MapRenderer mr;
+		request_handler::RequestHandler rh(mr);
+		json_reader::JsonReader reader(rh);
+		std::stringstream stream = ToStream(json::Node(input));
+		reader.MakeBase(stream);
+	}
+
+	void UpdateBase(const json::Dict& input)
+	{
+		renderer::MapRenderer mr;
+		request_handler::RequestHandler rh(mr);
+		json_reader::JsonReader reader(rh);
+		std::stringstream stream = ToStream(json::Node(input));
+		reader.UpdateBase(stream);
+	}
+
+	std::string ProcessRequests(const std::string& file, json::Array stat_requests)
+	{
+		renderer::MapRenderer mr;
+		request_handler::RequestHandler rh(mr);
+		json_reader::JsonReader reader(rh);
+		std::stringstream stream = ToStream(json::Node(json::Dict{
+			{ "serialization_settings"s, json::Node(json::Dict{ { "file"s, json::Node(file) } }) },
+			{ "stat_requests"s,          json::Node(std::move(stat_requests)) }
+		}));
+		std::ostringstream out;
+		reader.ProcessRequests(stream, out);
+		return out.str();
+	}
+
+	LoadedBase::LoadedBase(const std::string& file, json::Dict settings) : rh(mr)
+	{
+		json_reader::JsonReader reader(rh);
+		settings["serialization_settings"s] = json::Node(json::Dict{ { "file"s, json::Node(file) } });
+		std::stringstream stream = ToStream(json::Node(std::move(settings)));
+		std::ostringstream out;
+		reader.ProcessRequests(stream, out);
+		snapshot = rh.AcquireSnapshot();
+	}
+
+	int RunCases(const std::vector<Case>& cases, int argc, char* argv[])
+	{
+		const std::string only = (argc > 1) ? argv[1] : ""s;
+		int failed = 0;
+		bool found = only.empty();
+		for (const auto& [name, run] : cases)
+		{
+			if (!only.empty() && name != only) { continue; }
+
+			found = true;
+			try
+			{
+				run();
+				std::cerr << "ok "sv << name << '\n';
+			}
+			catch (const std::exception& e)
+			{
+				std::cerr << "FAILED "sv << name << ": "sv << e.what() << '\n';
+				++failed;
+			}
+		}
+		if (!found)
+		{
+			std::cerr << "Unknown case "sv << only << '\n';
+			return 1;
+		}
+		return failed == 0 ? 0 : 1;
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "json.h"
+#include "map_renderer.h"
+#include "request_handler.h"
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Fails the running case with the condition and where it is
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			throw std::runtime_error(std::string(__FILE__) + ":" + std::to_string(__LINE__) + ": " #condition); \
+		} \
+	} while (false)
+
+namespace tests
+{
+	// A path in the temporary directory for a base, removed with the object
+	class TempFile
+	{
+	public:
+		explicit TempFile(const std::string& name);
+		~TempFile();
+		TempFile(const TempFile&) = delete;
+		TempFile& operator=(const TempFile&) = delete;
+
+		const std::string& Path() const;
+
+	private:
+		std::string path_;
+	};
+
+	// Base requests of a generated network: stops scattered over a few kilometres and buses
+	// through random stops, half of them roundtrips. Every pair of consecutive route stops gets
+	// a road distance in one direction, some in both; names are partly not ASCII
+	json::Array MakeNetwork(size_t stop_count, size_t bus_count, unsigned seed);
+
+	// make_base or update_base input for the requests, with fixed routing and render settings;
+	// stat_settings only when the mode is given
+	json::Dict MakeBaseInput(json::Array base_requests, const std::string& file, std::optional<bool> approximate_length = {});
+
+	// Each runs one mode as main does, with a handler of its own
+	void MakeBase(const json::Dict& input);
+	void UpdateBase(const json::Dict& input);
+	std::string ProcessRequests(const std::string& file, json::Array stat_requests);
+
+	// A base loaded and published as process_requests does, to be queried through the handler.
+	// The settings are added to the process_requests input, e.g. routing_settings of the session
+	struct LoadedBase
+	{
+		explicit LoadedBase(const std::string& file, json::Dict settings = {});
+
+		renderer::MapRenderer mr;
+		request_handler::RequestHandler rh;
+		std::shared_ptr<const transport::Snapshot> snapshot;
+	};
+
+	using Case = std::pair<std::string, std::function<void()>>;
+
+	// Runs the case named by the only argument, or every case without one. Returns the exit code
+	int RunCases(const std::vector<Case>& cases, int argc, char* argv[]);
+}
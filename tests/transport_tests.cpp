@@ -0,0 +1,824 @@
+#include "test_helpers.h"
+
+#include "json_reader.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <streambuf>
+#include <string_view>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std::literals;
+
+namespace
+{
+	// Every allocation made through operator new, see TestRouteQueriesDoNotAllocate
+	std::atomic<size_t> allocations{ 0u };
+}
+
+// GCC takes the free of a pointer from this operator new, once inlined into a caller, for
+// a mismatched pair
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t size)
+{
+	allocations.fetch_add(1u, std::memory_order_relaxed);
+	if (void* memory = std::malloc(size == 0u ? 1u : size))
+	{
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+namespace
+{
+	const std::string& NameOf(const json::Node& request)
+	{
+		return request.AsDict().at("name"s).AsString();
+	}
+
+	bool IsStop(const json::Node& request)
+	{
+		return request.AsDict().at("type"s).AsString() == "Stop"s;
+	}
+
+	std::vector<std::string> NamesOf(const json::Array& requests, bool stops)
+	{
+		std::vector<std::string> names;
+		for (const json::Node& request : requests)
+		{
+			if (IsStop(request) == stops)
+			{
+				names.push_back(NameOf(request));
+			}
+		}
+		return names;
+	}
+
+	// Every stop and bus by name, routes between spread out pairs of stops, the map and
+	// a search listing all names in order
+	json::Array MakeStatRequests(const std::vector<std::string>& stops, const std::vector<std::string>& buses)
+	{
+		json::Array requests;
+		int id = 1;
+		const auto add = [&](json::Dict request)
+		{
+			request["id"s] = json::Node(id++);
+			requests.push_back(std::move(request));
+		};
+		for (const std::string& stop : stops)
+		{
+			add({ { "type"s, json::Node("Stop"s) }, { "name"s, json::Node(stop) } });
+		}
+		for (const std::string& bus : buses)
+		{
+			add({ { "type"s, json::Node("Bus"s) }, { "name"s, json::Node(bus) } });
+		}
+		for (size_t i = 0u; i < stops.size(); i += 3u)
+		{
+			add({ { "type"s, json::Node("Route"s) }, { "from"s, json::Node(stops[i]) },
+				{ "to"s, json::Node(stops[(i * 7u + 11u) % stops.size()]) } });
+		}
+		add({ { "type"s, json::Node("Search"s) }, { "query"s, json::Node(""s) } });
+		add({ { "type"s, json::Node("Map"s) } });
+		return requests;
+	}
+
+	// Same stats to the last bit for every bus of either base, where the answers only print six digits
+	void CheckSameBusStats(const std::string& first_file, const std::string& second_file)
+	{
+		const tests::LoadedBase first(first_file);
+		const tests::LoadedBase second(second_file);
+		CHECK(first.rh.GetBuses(*first.snapshot).size() == second.rh.GetBuses(*second.snapshot).size());
+		for (const domain::BusView bus : first.rh.GetBuses(*first.snapshot))
+		{
+			const auto first_info = first.rh.GetBusInfo(*first.snapshot, bus.Name());
+			const auto second_info = second.rh.GetBusInfo(*second.snapshot, bus.Name());
+			CHECK(second_info);
+			CHECK(first_info->stops_on_route == second_info->stops_on_route);
+			CHECK(first_info->unique_stops == second_info->unique_stops);
+			CHECK(first_info->routh_actual_length == second_info->routh_actual_length);
+			CHECK(first_info->curvature == second_info->curvature);
+		}
+	}
+
+	// A delta of moved, added and removed stops and buses, and the full requests it makes of
+	// the network, in the order update_base documents: kept stops in place with the removed
+	// ones squeezed out, new stops last, then kept buses followed by the delta's
+	struct NetworkDelta
+	{
+		json::Array delta;
+		json::Array merged;
+	};
+
+	NetworkDelta MakeDelta(const json::Array& network)
+	{
+		std::vector<json::Dict> stops;
+		std::vector<json::Dict> buses;
+		for (const json::Node& request : network)
+		{
+			(IsStop(request) ? stops : buses).push_back(request.AsDict());
+		}
+
+		NetworkDelta result;
+		// Three stops moved, their road distances lengthened
+		std::map<std::string, json::Dict> replaced;
+		for (const size_t i : { 5u, 50u, 100u })
+		{
+			json::Dict stop = stops[i];
+			stop["latitude"s] = json::Node(stop.at("latitude"s).AsDouble() + 0.003);
+			json::Dict road_distances;
+			for (const auto& [to, distance] : stop.at("road_distances"s).AsDict())
+			{
+				road_distances[to] = json::Node(distance.AsInt() + 100);
+			}
+			stop["road_distances"s] = json::Node(std::move(road_distances));
+			replaced[stop.at("name"s).AsString()] = stop;
+			result.delta.push_back(stop);
+		}
+		// Two new stops
+		std::vector<json::Dict> added;
+		for (int i = 0; i < 2; ++i)
+		{
+			added.push_back({
+				{ "type"s,           json::Node("Stop"s)                       },
+				{ "name"s,           json::Node("New stop "s + std::to_string(i)) },
+				{ "latitude"s,       json::Node(55.6 + 0.01 * i)               },
+				{ "longitude"s,      json::Node(37.6)                          },
+				{ "road_distances"s, json::Node(json::Dict{ { stops[10u + i].at("name"s).AsString(), json::Node(1500 + i) } }) }
+			});
+			result.delta.push_back(added.back());
+		}
+		// Buses 0 and 1 removed, 2 and 3 given again through the first new stop, one bus added
+		std::set<std::string> removed_buses;
+		for (size_t i = 0u; i < 4u; ++i)
+		{
+			removed_buses.insert(buses[i].at("name"s).AsString());
+		}
+		for (size_t i = 0u; i < 2u; ++i)
+		{
+			result.delta.push_back(json::Dict{
+				{ "type"s,   json::Node("Bus"s)          },
+				{ "name"s,   buses[i].at("name"s)        },
+				{ "remove"s, json::Node(true)            }
+			});
+		}
+		std::vector<json::Dict> given;
+		for (size_t i = 2u; i < 4u; ++i)
+		{
+			json::Dict bus = buses[i];
+			const json::Array& old_stops = bus.at("stops"s).AsArray();
+			json::Array new_stops(old_stops.begin(), old_stops.begin() + 2);
+			new_stops.push_back(added[0].at("name"s));
+			if (bus.at("is_roundtrip"s).AsBool())
+			{
+				new_stops.push_back(new_stops.front());
+			}
+			bus["stops"s] = json::Node(std::move(new_stops));
+			given.push_back(std::move(bus));
+		}
+		given.push_back({
+			{ "type"s,         json::Node("Bus"s)   },
+			{ "name"s,         json::Node("Новый"s) },
+			{ "stops"s,        json::Node(json::Array{ added[0].at("name"s), added[1].at("name"s), stops[0].at("name"s) }) },
+			{ "is_roundtrip"s, json::Node(false)    }
+		});
+		for (const json::Dict& bus : given)
+		{
+			result.delta.push_back(bus);
+		}
+
+		// A stop no bus passes any more, nor a distance of the delta leads to
+		std::set<std::string> used;
+		for (size_t i = 2u; i < buses.size(); ++i)
+		{
+			for (const json::Node& stop : (i < 4u ? given[i - 2u] : buses[i]).at("stops"s).AsArray())
+			{
+				used.insert(stop.AsString());
+			}
+		}
+		for (const json::Dict& bus : given)
+		{
+			for (const json::Node& stop : bus.at("stops"s).AsArray())
+			{
+				used.insert(stop.AsString());
+			}
+		}
+		std::string removed_stop;
+		for (size_t i = 12u; i < stops.size() && removed_stop.empty(); ++i)
+		{
+			const std::string& name = stops[i].at("name"s).AsString();
+			if (!used.count(name) && !replaced.count(name))
+			{
+				removed_stop = name;
+			}
+		}
+		CHECK(!removed_stop.empty());
+		result.delta.push_back(json::Dict{
+			{ "type"s,   json::Node("Stop"s)     },
+			{ "name"s,   json::Node(removed_stop) },
+			{ "remove"s, json::Node(true)        }
+		});
+
+		for (const json::Dict& stop : stops)
+		{
+			const std::string& name = stop.at("name"s).AsString();
+			if (name == removed_stop) { continue; }
+
+			json::Dict kept = replaced.count(name) ? replaced.at(name) : stop;
+			json::Dict road_distances = kept.at("road_distances"s).AsDict();
+			road_distances.erase(removed_stop);
+			kept["road_distances"s] = json::Node(std::move(road_distances));
+			result.merged.push_back(std::move(kept));
+		}
+		for (const json::Dict& stop : added)
+		{
+			result.merged.push_back(stop);
+		}
+		for (const json::Dict& bus : buses)
+		{
+			if (!removed_buses.count(bus.at("name"s).AsString()))
+			{
+				result.merged.push_back(bus);
+			}
+		}
+		for (const json::Dict& bus : given)
+		{
+			result.merged.push_back(bus);
+		}
+		return result;
+	}
+
+	// update_base answers like make_base of the merged requests, and keeps the same stats
+	void TestUpdateBaseMatchesMakeBase()
+	{
+		const json::Array network = tests::MakeNetwork(120u, 50u, 1u);
+		const NetworkDelta delta = MakeDelta(network);
+
+		const tests::TempFile updated("update_base.db"s);
+		const tests::TempFile merged("update_base_merged.db"s);
+		tests::MakeBase(tests::MakeBaseInput(network, updated.Path()));
+		tests::UpdateBase(tests::MakeBaseInput(delta.delta, updated.Path()));
+		tests::MakeBase(tests::MakeBaseInput(delta.merged, merged.Path()));
+
+		// Names gone with the update are asked for as well
+		std::vector<std::string> stops = NamesOf(network, true);
+		std::vector<std::string> buses = NamesOf(network, false);
+		for (const std::string& name : NamesOf(delta.merged, true))
+		{
+			if (name.rfind("New stop "s, 0u) == 0u) { stops.push_back(name); }
+		}
+		buses.push_back("Новый"s);
+
+		const std::string answers = tests::ProcessRequests(updated.Path(), MakeStatRequests(stops, buses));
+		CHECK(answers == tests::ProcessRequests(merged.Path(), MakeStatRequests(stops, buses)));
+		// The removed names are not found, routes between the rest are
+		CHECK(answers.find("not found"s) != std::string::npos);
+		CHECK(answers.find("total_time"s) != std::string::npos);
+		CheckSameBusStats(updated.Path(), merged.Path());
+	}
+
+	// A base built with approximate lengths is updated in that mode unless the update names
+	// another, in which case every bus is computed in the new one
+	void TestUpdateBaseKeepsLengthMode()
+	{
+		const json::Array network = tests::MakeNetwork(120u, 50u, 2u);
+		const NetworkDelta delta = MakeDelta(network);
+
+		const tests::TempFile updated("length_mode.db"s);
+		const tests::TempFile merged("length_mode_merged.db"s);
+		tests::MakeBase(tests::MakeBaseInput(network, updated.Path(), true));
+		tests::UpdateBase(tests::MakeBaseInput(delta.delta, updated.Path()));
+		tests::MakeBase(tests::MakeBaseInput(delta.merged, merged.Path(), true));
+		CheckSameBusStats(updated.Path(), merged.Path());
+
+		tests::MakeBase(tests::MakeBaseInput(network, updated.Path(), true));
+		tests::UpdateBase(tests::MakeBaseInput(delta.delta, updated.Path(), false));
+		tests::MakeBase(tests::MakeBaseInput(delta.merged, merged.Path(), false));
+		CheckSameBusStats(updated.Path(), merged.Path());
+	}
+
+	// The mode is stored with a base that has no buses yet, so that the buses an update adds
+	// are computed in it
+	void TestLengthModeStoredWithoutBuses()
+	{
+		const json::Array network = tests::MakeNetwork(120u, 50u, 4u);
+		json::Array stops;
+		json::Array buses;
+		for (const json::Node& request : network)
+		{
+			(IsStop(request) ? stops : buses).push_back(request);
+		}
+
+		const tests::TempFile updated("length_mode_no_buses.db"s);
+		const tests::TempFile full("length_mode_full.db"s);
+		tests::MakeBase(tests::MakeBaseInput(stops, updated.Path(), true));
+		tests::UpdateBase(tests::MakeBaseInput(buses, updated.Path()));
+		tests::MakeBase(tests::MakeBaseInput(network, full.Path(), true));
+		CheckSameBusStats(updated.Path(), full.Path());
+	}
+
+	// Every name is found by the perfect hash stored with the base once it is read back, at the
+	// id it was added with, and names not in the base are not found
+	void TestNamesHashRoundTrip()
+	{
+		const json::Array network = tests::MakeNetwork(200u, 80u, 3u);
+		const tests::TempFile file("names_hash.db"s);
+		tests::MakeBase(tests::MakeBaseInput(network, file.Path()));
+		const tests::LoadedBase loaded(file.Path());
+		const transport::TransportCatalogue& catalogue = loaded.snapshot->catalogue;
+
+		const std::vector<std::string> stops = NamesOf(network, true);
+		const std::vector<std::string> buses = NamesOf(network, false);
+		CHECK(catalogue.GetStopNamesHash().keys.size() == stops.size());
+		CHECK(catalogue.GetBusNamesHash().keys.size() == buses.size());
+		for (size_t i = 0u; i < stops.size(); ++i)
+		{
+			const domain::StopView stop = catalogue.FindStop(stops[i]);
+			CHECK(stop && stop.Id() == i && stop.Name() == stops[i]);
+		}
+		for (size_t i = 0u; i < buses.size(); ++i)
+		{
+			const domain::BusView bus = catalogue.FindBus(buses[i]);
+			CHECK(bus && bus.Id() == i && bus.Name() == buses[i]);
+		}
+		for (const std::string& name : { ""s, "Stop"s, "Stop 200"s, "Stop 1 "s, "Остановка 1"s, "1к"s, "80"s })
+		{
+			CHECK(!catalogue.FindStop(name));
+			CHECK(!catalogue.FindBus(name));
+		}
+
+		// The layout alone restores the hash
+		std::vector<uint64_t> keys;
+		for (const std::string& name : stops)
+		{
+			keys.push_back(domain::PerfectHash::Hash(name));
+		}
+		domain::PerfectHash restored;
+		CHECK(restored.Restore(keys.size(), catalogue.GetStopNamesHash()));
+		for (size_t i = 0u; i < keys.size(); ++i)
+		{
+			CHECK(restored.Find(keys[i]) == i);
+		}
+
+		// A layout that does not fit the names is built anew rather than trusted
+		domain::PerfectHash::Layout shuffled = catalogue.GetStopNamesHash();
+		std::reverse(shuffled.seeds.begin(), shuffled.seeds.end());
+		domain::NameArena names;
+		for (const std::string& name : stops)
+		{
+			names.AddStored(name);
+		}
+		names.RestorePerfectHash(std::move(shuffled));
+		for (size_t i = 0u; i < stops.size(); ++i)
+		{
+			CHECK(names.Find(stops[i]) == i);
+		}
+	}
+
+	// DirectBuses gives the buses a scan over the requests' routes finds, in name order
+	void TestDirectBusesMatchScan()
+	{
+		const json::Array network = tests::MakeNetwork(120u, 50u, 4u);
+		const tests::TempFile file("direct_buses.db"s);
+		tests::MakeBase(tests::MakeBaseInput(network, file.Path()));
+		const tests::LoadedBase loaded(file.Path());
+		const transport::TransportCatalogue& catalogue = loaded.snapshot->catalogue;
+
+		// Whole routes by stop name, the way back included
+		std::map<std::string, std::vector<std::string>> routes;
+		for (const json::Node& request : network)
+		{
+			if (IsStop(request)) { continue; }
+
+			std::vector<std::string>& route = routes[NameOf(request)];
+			for (const json::Node& stop : request.AsDict().at("stops"s).AsArray())
+			{
+				route.push_back(stop.AsString());
+			}
+			if (!request.AsDict().at("is_roundtrip"s).AsBool())
+			{
+				const std::vector<std::string> way_out = route;
+				route.insert(route.end(), way_out.rbegin() + 1, way_out.rend());
+			}
+		}
+
+		std::vector<size_t> rank_of(catalogue.GetBusCount());
+		for (size_t rank = 0u; rank < catalogue.GetBusesByName().size(); ++rank)
+		{
+			rank_of[catalogue.GetBusesByName()[rank]] = rank;
+		}
+
+		const std::vector<std::string> stops = NamesOf(network, true);
+		size_t found = 0u;
+		for (const std::string& from : stops)
+		{
+			for (const std::string& to : stops)
+			{
+				std::set<std::string> passing;
+				std::set<std::string> reaching;
+				for (const auto& [bus, route] : routes)
+				{
+					const auto from_it = std::find(route.begin(), route.end(), from);
+					if (from_it == route.end() || std::find(route.begin(), route.end(), to) == route.end()) { continue; }
+
+					passing.insert(bus);
+					if (std::find(from_it + 1, route.end(), to) != route.end())
+					{
+						reaching.insert(bus);
+					}
+				}
+
+				for (const bool ordered : { false, true })
+				{
+					const auto buses = loaded.rh.FindDirectBuses(*loaded.snapshot, from, to, ordered);
+					CHECK(buses);
+					std::set<std::string> names;
+					for (size_t i = 0u; i < buses->size(); ++i)
+					{
+						names.insert(std::string(catalogue.GetBus((*buses)[i]).Name()));
+						CHECK(i == 0u || rank_of[(*buses)[i - 1u]] < rank_of[(*buses)[i]]);
+					}
+					CHECK(names == (ordered ? reaching : passing));
+				}
+				found += passing.size();
+			}
+		}
+		CHECK(found > stops.size());
+		CHECK(!loaded.rh.FindDirectBuses(*loaded.snapshot, stops[0], "No such stop"s, false));
+	}
+
+	// Bus stats computed over several threads are those of one thread, and those of the
+	// lengths computed bus by bus
+	void TestParallelBusStatsMatchSequential()
+	{
+		const json::Array network = tests::MakeNetwork(300u, 2000u, 5u);
+		transport::TransportCatalogue catalogue;
+		std::vector<domain::Bus> buses;
+		for (const json::Node& request : network)
+		{
+			const json::Dict& dict = request.AsDict();
+			if (IsStop(request))
+			{
+				catalogue.AddStop(domain::Stop(std::string(NameOf(request)), dict.at("latitude"s).AsDouble(), dict.at("longitude"s).AsDouble()));
+				continue;
+			}
+			std::vector<domain::StopId> route;
+			for (const json::Node& stop : dict.at("stops"s).AsArray())
+			{
+				route.push_back(catalogue.FindStop(stop.AsString()).Id());
+			}
+			buses.emplace_back(std::string(NameOf(request)), std::move(route), 0, 0, 0.0, dict.at("is_roundtrip"s).AsBool());
+		}
+		for (const json::Node& request : network)
+		{
+			if (!IsStop(request)) { continue; }
+
+			for (const auto& [to, distance] : request.AsDict().at("road_distances"s).AsDict())
+			{
+				catalogue.SetDistanceBetweenStops(NameOf(request), to, distance.AsInt());
+			}
+		}
+
+		for (const geo::DistanceMode mode : { geo::DistanceMode::EXACT, geo::DistanceMode::APPROXIMATE })
+		{
+			std::vector<domain::Bus> parallel = buses;
+			std::vector<domain::Bus> sequential = buses;
+			setenv("TRANSPORT_THREADS", "4", 1);
+			CHECK(parallel::ThreadsFor(parallel.size(), 64u) == 4u);
+			catalogue.ComputeBusStats(parallel, mode);
+			setenv("TRANSPORT_THREADS", "1", 1);
+			catalogue.ComputeBusStats(sequential, mode);
+			unsetenv("TRANSPORT_THREADS");
+
+			for (size_t i = 0u; i < buses.size(); ++i)
+			{
+				const domain::RouteStops route = domain::MakeRouteStops(buses[i].route.data(), buses[i].route.size(), buses[i].roundtrip);
+				const std::set<domain::StopId> unique(buses[i].route.begin(), buses[i].route.end());
+				CHECK(parallel[i].unique_stops == static_cast<int>(unique.size()));
+				CHECK(parallel[i].route_actual_length == catalogue.ComputeActualLength(route));
+				CHECK(parallel[i].route_geographic_length == catalogue.ComputeGeographicLength(route, mode));
+				CHECK(parallel[i].unique_stops == sequential[i].unique_stops);
+				CHECK(parallel[i].route_actual_length == sequential[i].route_actual_length);
+				CHECK(parallel[i].route_geographic_length == sequential[i].route_geographic_length);
+			}
+		}
+	}
+
+	json::Node StopRequest(const std::string& name, double lat, double lng)
+	{
+		return json::Dict{
+			{ "type"s,           json::Node("Stop"s)     },
+			{ "name"s,           json::Node(name)        },
+			{ "latitude"s,       json::Node(lat)         },
+			{ "longitude"s,      json::Node(lng)         },
+			{ "road_distances"s, json::Node(json::Dict{}) }
+		};
+	}
+
+	json::Node BusRequest(const std::string& name, const std::vector<std::string>& stops, bool roundtrip)
+	{
+		return json::Dict{
+			{ "type"s,         json::Node("Bus"s)                                      },
+			{ "name"s,         json::Node(name)                                        },
+			{ "stops"s,        json::Node(json::Array(stops.begin(), stops.end()))     },
+			{ "is_roundtrip"s, json::Node(roundtrip)                                   }
+		};
+	}
+
+	// Busiest stops come most buses first and ties in name order, not in the order added;
+	// a bus passing a stop twice counts once
+	void TestAnalyticsBusiestStopsTies()
+	{
+		const json::Array requests = {
+			StopRequest("Delta"s, 55.60, 37.60),
+			StopRequest("Bravo"s, 55.61, 37.61),
+			StopRequest("Alpha"s, 55.62, 37.62),
+			StopRequest("Charlie"s, 55.63, 37.63),
+			StopRequest("Echo"s, 55.64, 37.64),
+			BusRequest("1"s, { "Delta"s, "Bravo"s, "Alpha"s, "Charlie"s }, false),
+			BusRequest("2"s, { "Bravo"s, "Alpha"s }, false),
+			BusRequest("3"s, { "Charlie"s, "Delta"s, "Charlie"s }, true),
+			BusRequest("4"s, { "Charlie"s, "Echo"s }, false)
+		};
+		const tests::TempFile file("analytics_ties.db"s);
+		tests::MakeBase(tests::MakeBaseInput(requests, file.Path()));
+		const tests::LoadedBase loaded(file.Path());
+
+		const auto busiest = [&loaded](size_t count)
+		{
+			domain::AnalyticsOptions options;
+			options.busiest_stops = count;
+			std::vector<std::pair<std::string, size_t>> stops;
+			for (const domain::BusiestStop& stop : loaded.rh.GetNetworkAnalytics(*loaded.snapshot, options).busiest_stops)
+			{
+				stops.emplace_back(loaded.rh.GetStopName(*loaded.snapshot, stop.stop), stop.bus_count);
+			}
+			return stops;
+		};
+		using Expected = std::vector<std::pair<std::string, size_t>>;
+		CHECK(busiest(3u) == (Expected{ { "Charlie"s, 3u }, { "Alpha"s, 2u }, { "Bravo"s, 2u } }));
+		CHECK(busiest(10u) == (Expected{ { "Charlie"s, 3u }, { "Alpha"s, 2u }, { "Bravo"s, 2u }, { "Delta"s, 2u }, { "Echo"s, 1u } }));
+		CHECK(busiest(0u).empty());
+	}
+
+	// The other aggregates against sums and counts over the stats of every bus and route
+	void TestAnalyticsMatchesBusAndRouteAnswers()
+	{
+		const json::Array network = tests::MakeNetwork(60u, 30u, 6u);
+		const tests::TempFile file("analytics.db"s);
+		tests::MakeBase(tests::MakeBaseInput(network, file.Path()));
+		const tests::LoadedBase loaded(file.Path());
+		const transport::Snapshot& snapshot = *loaded.snapshot;
+
+		domain::AnalyticsOptions options;
+		options.route_length = options.curvature = options.travel_time = true;
+		const domain::NetworkAnalytics analytics = loaded.rh.GetNetworkAnalytics(snapshot, options);
+
+		double route_length = 0.0;
+		double geographic_length = 0.0;
+		std::vector<double> curvatures;
+		for (const domain::BusView bus : loaded.rh.GetBuses(snapshot))
+		{
+			route_length += bus.RouteActualLength();
+			geographic_length += bus.RouteGeographicLength();
+			if (bus.RouteGeographicLength() > 0.0)
+			{
+				curvatures.push_back(loaded.rh.GetBusInfo(snapshot, bus.Name())->curvature);
+			}
+		}
+		const auto near = [](double first, double second) { return std::abs(first - second) <= 1e-9 * std::max(1.0, std::abs(second)); };
+		CHECK(analytics.route_length && near(*analytics.route_length, route_length));
+		CHECK(near(*analytics.geographic_length, geographic_length));
+		CHECK(analytics.curvature && analytics.curvature->count == curvatures.size());
+		CHECK(near(analytics.curvature->min, *std::min_element(curvatures.begin(), curvatures.end())));
+		CHECK(near(analytics.curvature->max, *std::max_element(curvatures.begin(), curvatures.end())));
+
+		std::vector<double> times;
+		transport::RouteInfo route;
+		for (const domain::StopView from : loaded.rh.GetStops(snapshot))
+		{
+			for (const domain::StopView to : loaded.rh.GetStops(snapshot))
+			{
+				if (from.Id() != to.Id() && loaded.rh.GetRouteInfo(snapshot, from.Name(), to.Name(), {}, {}, route))
+				{
+					times.push_back(route.total_time);
+				}
+			}
+		}
+		CHECK(!times.empty());
+		CHECK(analytics.travel_time && analytics.travel_time->count == times.size());
+		double mean = 0.0;
+		for (const double time : times)
+		{
+			mean += time / static_cast<double>(times.size());
+		}
+		CHECK(near(analytics.travel_time->min, *std::min_element(times.begin(), times.end())));
+		CHECK(near(analytics.travel_time->max, *std::max_element(times.begin(), times.end())));
+		CHECK(near(analytics.travel_time->mean, mean));
+	}
+
+	// A distance set one way serves the other way too until that one is set, and a stop is
+	// 0 metres from itself unless set otherwise
+	void TestActualDistanceFallbacks()
+	{
+		transport::TransportCatalogue catalogue;
+		const domain::StopId a = catalogue.AddStop(domain::Stop("A"s, 55.60, 37.60));
+		const domain::StopId b = catalogue.AddStop(domain::Stop("B"s, 55.61, 37.61));
+		const domain::StopId c = catalogue.AddStop(domain::Stop("C"s, 55.62, 37.62));
+
+		catalogue.SetDistanceBetweenStops("A"s, "B"s, 100.0);
+		CHECK(catalogue.GetActualDistance(a, b) == 100.0);
+		CHECK(catalogue.GetActualDistance(b, a) == 100.0);
+		catalogue.SetDistanceBetweenStops("B"s, "A"s, 150.0);
+		CHECK(catalogue.GetActualDistance(a, b) == 100.0);
+		CHECK(catalogue.GetActualDistance(b, a) == 150.0);
+		catalogue.SetDistanceBetweenStops("A"s, "B"s, 120.0);
+		CHECK(catalogue.GetActualDistance(a, b) == 120.0);
+
+		CHECK(catalogue.GetActualDistance(a, a) == 0.0);
+		CHECK(catalogue.GetActualDistance(c, c) == 0.0);
+		catalogue.SetDistanceBetweenStops("C"s, "C"s, 20.0);
+		CHECK(catalogue.GetActualDistance(c, c) == 20.0);
+		CHECK(!catalogue.GetActualDistance(a, c));
+		CHECK(!catalogue.GetActualDistance(c, b));
+		CHECK(catalogue.GetActualDistanceBetweenStops("B"s, "A"s) == 150.0);
+		CHECK(!catalogue.GetActualDistanceBetweenStops("A"s, "D"s));
+
+		// The table itself keeps each direction apart, through any number of growths
+		transport::DistanceTable table;
+		std::map<std::pair<domain::StopId, domain::StopId>, int> expected;
+		for (domain::StopId from = 0u; from < 3000u; ++from)
+		{
+			for (const domain::StopId to : { from * 7u % 3001u, from + 1u })
+			{
+				table.Set(from, to, static_cast<int>(from + to));
+				expected[{ from, to }] = static_cast<int>(from + to);
+			}
+		}
+		CHECK(table.Size() == expected.size());
+		for (const auto& [stops, distance] : expected)
+		{
+			CHECK(table.Find(stops.first, stops.second) == distance);
+			if (!expected.count({ stops.second, stops.first }))
+			{
+				CHECK(!table.Find(stops.second, stops.first));
+			}
+		}
+		size_t visited = 0u;
+		table.ForEach([&](domain::StopId from, domain::StopId to, int distance)
+		{
+			CHECK(expected.at({ from, to }) == distance);
+			++visited;
+		});
+		CHECK(visited == expected.size());
+	}
+
+	// Once a thread's buffers have grown to the longest route, queries on the base metric (read
+	// from the routes table) and on the session metric (searched) allocate nothing, via points
+	// or not. Only the router is checked: the JSON answer allocates per item
+	void TestRouteQueriesDoNotAllocate()
+	{
+		const json::Array network = tests::MakeNetwork(120u, 50u, 7u);
+		const tests::TempFile file("route_allocations.db"s);
+		tests::MakeBase(tests::MakeBaseInput(network, file.Path()));
+		const tests::LoadedBase loaded(file.Path(), { { "routing_settings"s, json::Node(json::Dict{
+			{ "bus_wait_time"s, json::Node(2) },
+			{ "bus_velocity"s,  json::Node(50) }
+		}) } });
+
+		std::vector<std::string_view> stops;
+		for (const domain::StopView stop : loaded.rh.GetStops(*loaded.snapshot))
+		{
+			stops.push_back(stop.Name());
+		}
+		transport::RouteInfo route;
+		const auto run = [&](const transport::RouteOptions& options, const std::vector<std::string_view>& via)
+		{
+			size_t found = 0u;
+			for (size_t i = 0u; i < stops.size(); ++i)
+			{
+				const std::string_view to = stops[(i * 7u + 11u) % stops.size()];
+				found += loaded.rh.GetRouteInfo(*loaded.snapshot, stops[i], to, via, options, route) ? 1u : 0u;
+			}
+			return found;
+		};
+
+		// The base settings given explicitly leave the session metric for the table
+		transport::RouteOptions base_metric;
+		base_metric.bus_wait_time = 4.0;
+		base_metric.bus_velocity = 30.0;
+		const transport::RouteOptions session_metric;
+		const std::vector<std::string_view> via = { stops[3], stops[40] };
+		for (const auto& [options, via_stops] : { std::make_pair(base_metric, std::vector<std::string_view>{}), 
+			std::make_pair(base_metric, via), std::make_pair(session_metric, std::vector<std::string_view>{}), 
+			std::make_pair(session_metric, via) })
+		{
+			const size_t found = run(options, via_stops);
+			const size_t before = allocations.load();
+			CHECK(run(options, via_stops) == found);
+			CHECK(allocations.load() == before);
+			CHECK(found > 0u);
+		}
+	}
+
+	// Drops what is written, so that a stream over it never grows a buffer
+	class DiscardBuffer : public std::streambuf
+	{
+	protected:
+		int_type overflow(int_type c) override
+		{
+			return traits_type::not_eof(c);
+		}
+	};
+
+	// A whole batch of Route requests, from the parsed requests to the written answers. The
+	// answers must also be laid out as printing them as a document would
+	void TestRouteAnswersDoNotAllocate()
+	{
+		const json::Array network = tests::MakeNetwork(120u, 50u, 7u);
+		const tests::TempFile file("route_answer_allocations.db"s);
+		tests::MakeBase(tests::MakeBaseInput(network, file.Path()));
+		tests::LoadedBase loaded(file.Path());
+		const json_reader::JsonReader reader(loaded.rh);
+
+		std::vector<std::string> stops;
+		for (const domain::StopView stop : loaded.rh.GetStops(*loaded.snapshot))
+		{
+			stops.emplace_back(stop.Name());
+		}
+		json::Array requests;
+		for (size_t i = 0u; i < stops.size(); ++i)
+		{
+			json::Dict request = {
+				{ "id"s,   json::Node(static_cast<int>(i)) },
+				{ "type"s, json::Node("Route"s) },
+				{ "from"s, json::Node(stops[i]) },
+				{ "to"s,   json::Node(i % 10u == 9u ? "No such stop"s : stops[(i * 7u + 11u) % stops.size()]) }
+			};
+			if (i % 3u == 0u)
+			{
+				request["via"s] = json::Node(json::Array{ json::Node(stops[(i + 5u) % stops.size()]) });
+			}
+			requests.push_back(json::Node(std::move(request)));
+		}
+
+		std::ostringstream answers;
+		reader.AnswerStatRequests(requests, answers);
+		std::istringstream parsed_input(answers.str());
+		const json::Document parsed = json::Load(parsed_input);
+		std::ostringstream printed;
+		json::Print(parsed, printed);
+		CHECK(printed.str() == answers.str());
+		CHECK(parsed.GetRoot().AsArray().size() == requests.size());
+		size_t found = 0u;
+		for (const json::Node& answer : parsed.GetRoot().AsArray())
+		{
+			found += answer.AsDict().count("items"s);
+		}
+		CHECK(found > requests.size() / 2u);
+
+		DiscardBuffer discard;
+		std::ostream sink(&discard);
+		const size_t before = allocations.load();
+		reader.AnswerStatRequests(requests, sink);
+		CHECK(allocations.load() == before);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	return tests::RunCases({
+		{ "update_base_matches_make_base"s, TestUpdateBaseMatchesMakeBase },
+		{ "update_base_keeps_length_mode"s, TestUpdateBaseKeepsLengthMode },
+		{ "length_mode_stored_without_buses"s, TestLengthModeStoredWithoutBuses },
+		{ "names_hash_round_trip"s,         TestNamesHashRoundTrip },
+		{ "direct_buses_match_scan"s,       TestDirectBusesMatchScan },
+		{ "parallel_bus_stats_match_sequential"s, TestParallelBusStatsMatchSequential },
+		{ "analytics_busiest_stops_ties"s,  TestAnalyticsBusiestStopsTies },
+		{ "analytics_matches_bus_and_route_answers"s, TestAnalyticsMatchesBusAndRouteAnswers },
+		{ "actual_distance_fallbacks"s,     TestActualDistanceFallbacks },
+		{ "route_queries_do_not_allocate"s, TestRouteQueriesDoNotAllocate },
+		{ "route_answers_do_not_allocate"s, TestRouteAnswersDoNotAllocate }
+	}, argc, argv);
+}